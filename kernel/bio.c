@@ -7,7 +7,8 @@
 //
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
-// * After changing buffer data, call bwrite to write it to disk.
+// * After changing buffer data, call bwrite to write it to disk,
+//     or bwriten to write several at once.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
@@ -19,9 +20,12 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
+#include "rusage.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 struct {
   struct spinlock lock;
@@ -95,20 +99,53 @@ bread(uint dev, uint blockno)
   struct buf *b;
 
   b = bget(dev, blockno);
+  TRACE(TR_BREAD, blockno, b->valid);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
+    if(myproc())
+      myproc()->ru.inblock++;
+    iosched_rw(&b, 1, 0);
     b->valid = 1;
   }
   return b;
 }
 
+// Return a locked buf for the indicated block without
+// reading it from disk, for a caller that will overwrite
+// all of b->data.
+struct buf*
+bnew(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->valid = 1;
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  TRACE(TR_BWRITE, b->blockno, 0);
+  iosched_rw(&b, 1, 1);
+}
+
+// Write the n bufs in bs to disk.  Must be locked.
+// The I/O scheduler sorts them and merges adjacent
+// blocks, so this is faster than n calls to bwrite.
+void
+bwriten(struct buf **bs, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("bwriten");
+    TRACE(TR_BWRITE, bs[i]->blockno, 0);
+  }
+  iosched_rw(bs, n, 1);
 }
 
 // Release a locked buffer.
@@ -7,6 +7,11 @@ struct buf {
   uint refcnt;
   struct buf *prev; // LRU cache list
   struct buf *next;
+  struct buf *qnext; // iosched queue, or rest of a disk request
+  int write;         // iosched: write (vs read) the disk
+  uint deadline;     // iosched: send by this tick
+  struct buf *fnext; // iosched: arrival order, by direction
+  struct buf *fprev;
   uchar data[BSIZE];
 };
 
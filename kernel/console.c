@@ -1,6 +1,7 @@
 //
 // Console input and output, to the uart.
-// Reads are line at a time.
+// Reads are line at a time, unless the console
+// is in raw mode (see consoleioctl()).
 // Implements special input characters:
 //   newline -- end of line
 //   control-h -- backspace
@@ -19,7 +20,9 @@
 #include "file.h"
 #include "memlayout.h"
 #include "riscv.h"
+#include "fcntl.h"
 #include "defs.h"
+#include "rusage.h"
 #include "proc.h"
 
 #define BACKSPACE 0x100
@@ -27,8 +30,8 @@
 
 //
 // send one character to the uart.
-// called by printf, and to echo input characters,
-// but not from write().
+// called by panic(), and to echo input characters,
+// but not from write() or other printf()s.
 //
 void
 consputc(int c)
@@ -45,79 +48,97 @@ struct {
   struct spinlock lock;
   
   // input
-#define INPUT_BUF 128
+#define INPUT_BUF 1024
   char buf[INPUT_BUF];
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+  int raw; // CONSOLE_RAW: no echo or editing
 } cons;
 
 //
 // user write()s to the console go here.
+// copies a chunk at a time into the uart's
+// transmit buffer. takes no lock of its own,
+// since uartwrite() may sleep.
 //
 int
 consolewrite(int user_src, uint64 src, int n)
 {
-  int i;
+  char buf[128];
+  int i, m;
 
-  acquire(&cons.lock);
-  for(i = 0; i < n; i++){
-    char c;
-    if(either_copyin(&c, user_src, src+i, 1) == -1)
+  for(i = 0; i < n; i += m){
+    m = n - i;
+    if(m > sizeof(buf))
+      m = sizeof(buf);
+    if(either_copyin(buf, user_src, src+i, m) == -1)
       break;
-    uartputc(c);
+    uartwrite(buf, m);
   }
-  release(&cons.lock);
 
   return i;
 }
 
 //
 // user read()s from the console go here.
-// copy (up to) a whole input line to dst.
+// copy (up to) a whole input line to dst,
+// or in raw mode whatever input has arrived.
 // user_dist indicates whether dst is a user
 // or kernel address.
 //
 int
 consoleread(int user_dst, uint64 dst, int n)
 {
-  uint target;
-  int c;
-  char cbuf;
+  uint target, start, m;
+  int c, eof, eol;
 
   target = n;
   acquire(&cons.lock);
-  while(n > 0){
-    // wait until interrupt handler has put some
-    // input into cons.buffer.
-    while(cons.r == cons.w){
-      if(myproc()->killed){
-        release(&cons.lock);
-        return -1;
-      }
-      sleep(&cons.r, &cons.lock);
+  // wait until interrupt handler has put some
+  // input into cons.buffer.
+  while(cons.r == cons.w){
+    if(myproc()->killed){
+      release(&cons.lock);
+      return -1;
     }
+    sleep(&cons.r, &cons.lock);
+  }
 
-    c = cons.buf[cons.r++ % INPUT_BUF];
-
-    if(c == C('D')){  // end-of-file
-      if(n < target){
-        // Save ^D for next time, to make sure
-        // caller gets a 0-byte result.
-        cons.r--;
+  while(n > 0 && cons.r != cons.w){
+    // the bytes up to the end of the ring, through
+    // the end of a line, or up to an end-of-file.
+    start = cons.r % INPUT_BUF;
+    eof = eol = 0;
+    for(m = 0; m < n && cons.r + m != cons.w && start + m < INPUT_BUF; m++){
+      c = cons.buf[start + m];
+      if(!cons.raw && c == C('D')){
+        eof = 1;
+        break;
+      }
+      if(!cons.raw && c == '\n'){
+        m++;
+        eol = 1;
+        break;
       }
-      break;
     }
 
-    // copy the input byte to the user-space buffer.
-    cbuf = c;
-    if(either_copyout(user_dst, dst, &cbuf, 1) == -1)
+    // copy them to the user-space buffer.
+    if(m > 0 && either_copyout(user_dst, dst, &cons.buf[start], m) == -1)
       break;
+    cons.r += m;
+    dst += m;
+    n -= m;
 
-    dst++;
-    --n;
-
-    if(c == '\n'){
+    if(eof){
+      if(n == target){
+        // consume the ^D, so the caller gets a 0-byte
+        // result; otherwise save it for next time.
+        cons.r++;
+      }
+      break;
+    }
+    if(eol){
       // a whole line has arrived, return to
       // the user-level read().
       break;
@@ -139,6 +160,17 @@ consoleintr(int c)
 {
   acquire(&cons.lock);
 
+  if(cons.raw){
+    // no echo or editing; hand each byte over at once.
+    if(cons.e-cons.r < INPUT_BUF){
+      cons.buf[cons.e++ % INPUT_BUF] = c;
+      cons.w = cons.e;
+      wakeup(&cons.r);
+    }
+    release(&cons.lock);
+    return;
+  }
+
   switch(c){
   case C('P'):  // Print process list.
     procdump();
@@ -180,6 +212,38 @@ consoleintr(int c)
   release(&cons.lock);
 }
 
+//
+// ioctl() on the console: get or set the input mode.
+//
+int
+consoleioctl(int req, uint64 arg)
+{
+  int r = 0;
+
+  acquire(&cons.lock);
+  switch(req){
+  case CONSOLE_GETMODE:
+    r = cons.raw;
+    break;
+  case CONSOLE_SETMODE:
+    if(arg != CONSOLE_COOKED && arg != CONSOLE_RAW){
+      r = -1;
+      break;
+    }
+    cons.raw = arg;
+    if(cons.raw && cons.w != cons.e){
+      // a partly typed line is now ready to read.
+      cons.w = cons.e;
+      wakeup(&cons.r);
+    }
+    break;
+  default:
+    r = -1;
+  }
+  release(&cons.lock);
+  return r;
+}
+
 void
 consoleinit(void)
 {
@@ -187,8 +251,9 @@ consoleinit(void)
 
   uartinit();
 
-  // connect read and write system calls
-  // to consoleread and consolewrite.
+  // connect read, write and ioctl system calls
+  // to consoleread, consolewrite and consoleioctl.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].ioctl = consoleioctl;
 }
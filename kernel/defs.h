@@ -1,7 +1,10 @@
 struct buf;
 struct context;
+struct diskstat;
 struct file;
 struct inode;
+struct iovec;
+struct lockstat;
 struct pipe;
 struct proc;
 struct spinlock;
@@ -12,8 +15,10 @@ struct superblock;
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bnew(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwriten(struct buf**, int);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
 
@@ -31,8 +36,14 @@ void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
+int             filereadv(struct file*, struct iovec*, int);
+int             filepread(struct file*, uint64, int n, uint off);
+int             filesplice(struct file*, struct file*, int n);
 int             filestat(struct file*, uint64 addr);
+int             fileioctl(struct file*, int, uint64);
 int             filewrite(struct file*, uint64, int n);
+int             filewritev(struct file*, struct iovec*, int);
+int             filepwrite(struct file*, uint64, int n, uint off);
 
 // fs.c
 void            fsinit(int);
@@ -45,6 +56,8 @@ void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
+void            ilockshared(struct inode*);
+void            iunlockshared(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
@@ -67,19 +80,30 @@ void            kinit(void);
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
+void            log_cancel(uint);
+void            log_sync(void);
 void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             piperead(struct pipe*, int, uint64, int);
+int             pipewrite(struct pipe*, int, uint64, int);
+int             pipespace(struct pipe*);
 
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
+int             klogtx(char*, int);
+int             dmesg(uint64, int);
+
+// prof.c
+extern volatile int profiling;
+void            profinit(void);
+void            profsample(void);
+int             prof(int, uint64, int);
 
 // proc.c
 int             cpuid(void);
@@ -98,7 +122,9 @@ void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
+void            kthread(void (*)(void), char*);
 int             wait(uint64);
+int             getrusage(int, uint64);
 void            wakeup(void*);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
@@ -116,9 +142,15 @@ void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// lockstat.c
+struct lockstat* lockstatfor(char*, int);
+int             lockstatcopy(uint64, int, int);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
@@ -126,6 +158,8 @@ void            initsleeplock(struct sleeplock*, char*);
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
 void*           memset(void*, int, uint);
+void            pagezero(void*);
+void            pagecopy(void*, const void*);
 char*           safestrcpy(char*, const char*, int);
 int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
@@ -146,18 +180,29 @@ void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
 
+// trace.c
+extern volatile int tracing;
+void            traceinit(void);
+void            tracerecord(int, uint64, uint64);
+int             ktrace(int, uint64, int);
+// record an event if tracing is on; costs one test when it is off.
+#define TRACE(type, a0, a1) do { if(tracing) tracerecord(type, a0, a1); } while(0)
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
-void            uartputc(int);
+void            uartwrite(char*, int);
 void            uartputc_sync(int);
+void            uartkick(void);
 int             uartgetc(void);
 
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
-uint64          kvmpa(uint64);
 void            kvmmap(uint64, uint64, uint64, int);
+pagetable_t     kvmcreate(void);
+void            kvmfree(pagetable_t);
+void            kvmsync(pagetable_t, pagetable_t);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
@@ -172,6 +217,10 @@ int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 
+// vmcopyin.S
+int             copyuser(void*, const void*, uint64);
+int             copyuserstr(char*, const char*, uint64);
+
 // plic.c
 void            plicinit(void);
 void            plicinithart(void);
@@ -180,8 +229,16 @@ void            plic_complete(int);
 
 // virtio_disk.c
 void            virtio_disk_init(void);
-void            virtio_disk_rw(struct buf *, int);
+int             virtio_disk_nqueue(void);
+void            virtio_disk_start(int, struct buf *, int, int);
 void            virtio_disk_intr(void);
+void            virtio_disk_stat(struct diskstat*);
+
+// iosched.c
+void            ioschedinit(void);
+void            iosched_rw(struct buf**, int, int);
+void            iosched_done(int, struct buf*);
+int             diskstat(uint64);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
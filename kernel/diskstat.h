@@ -0,0 +1,16 @@
+// Disk driver counters, as returned by diskstat().
+// Both the kernel and user programs use this header file.
+
+struct diskstat {
+  uint64 nqueue;     // virtqueues in use
+  uint64 nio;        // requests given to the device
+  uint64 ncomplete;  // requests the device has finished
+  uint64 nintr;      // disk interrupts
+  uint64 nnotify;    // times the driver notified the device
+  uint64 nnotifyskip; // notifications the device said it didn't need
+
+  // from the I/O scheduler, iosched.c.
+  uint64 nblock;     // blocks the buffer cache asked for
+  uint64 nmerged;    // blocks merged into another block's request
+  uint64 nexpired;   // requests sent out of order by their deadline
+};
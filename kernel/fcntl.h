@@ -3,3 +3,11 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+
+// ioctl() requests for the console.
+#define CONSOLE_SETMODE 1   // set the input mode to arg
+#define CONSOLE_GETMODE 2   // return the input mode
+
+// console input modes.
+#define CONSOLE_COOKED 0    // echo, line editing, reads return a line
+#define CONSOLE_RAW    1    // bytes as typed, reads return what's there
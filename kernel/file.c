@@ -11,6 +11,8 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "stat.h"
+#include "uio.h"
+#include "rusage.h"
 #include "proc.h"
 
 struct devsw devsw[NDEV];
@@ -101,27 +103,132 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
-// Read from file f.
-// addr is a user virtual address.
+// Device-specific control request req, with argument arg.
 int
-fileread(struct file *f, uint64 addr, int n)
+fileioctl(struct file *f, int req, uint64 arg)
+{
+  if(f->type != FD_DEVICE)
+    return -1;
+  if(f->major < 0 || f->major >= NDEV || !devsw[f->major].ioctl)
+    return -1;
+  return devsw[f->major].ioctl(req, arg);
+}
+
+// Read the buffers described by iov[0..cnt-1] from inode ip,
+// starting at *poff and advancing it. Stops early at end of file.
+// Returns -1 if a buffer is a bad user address.
+// ip->lock is taken once for the whole vector, shared with
+// other readers if shared is set; that is only safe if no
+// other process can be using *poff at the same time.
+static int
+inoderead(struct inode *ip, int user_dst, struct iovec *iov, int cnt, uint *poff, int shared)
+{
+  int i, r, tot = 0;
+
+  if(shared)
+    ilockshared(ip);
+  else
+    ilock(ip);
+  for(i = 0; i < cnt; i++){
+    r = readi(ip, user_dst, (uint64)iov[i].iov_base, *poff, iov[i].iov_len);
+    if(r < 0){
+      tot = -1;
+      break;
+    }
+    *poff += r;
+    tot += r;
+    if(r != iov[i].iov_len)
+      break;
+  }
+  if(shared)
+    iunlockshared(ip);
+  else
+    iunlock(ip);
+  return tot;
+}
+
+// Is f used only by this process, so that no one else can
+// be moving f->off? Another process can only get a reference
+// to f by fork() from this one, which is busy in a system call.
+static int
+fileprivate(struct file *f)
+{
+  return f->ref == 1;
+}
+
+// Write the buffers described by iov[0..cnt-1] to inode ip,
+// starting at *poff and advancing it.
+static int
+inodewrite(struct inode *ip, int user_src, struct iovec *iov, int cnt, uint *poff)
+{
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size, including
+  // i-node, indirect block, allocation blocks,
+  // and 2 blocks of slop for non-aligned writes.
+  // this really belongs lower down, since writei()
+  // might be writing a device like the console.
+  // the pieces of a vector land back to back in the
+  // file, so several of them can share a transaction
+  // as long as their total stays under max.
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  int i = 0, r = 0, tot = 0;
+  uint64 done = 0;   // bytes of iov[i] already written
+
+  while(i < cnt){
+    int room = max;
+
+    begin_op();
+    ilock(ip);
+    while(i < cnt && room > 0){
+      int n1 = iov[i].iov_len - done;
+      if(n1 > room)
+        n1 = room;
+      if((r = writei(ip, user_src, (uint64)iov[i].iov_base + done, *poff, n1)) > 0)
+        *poff += r;
+      if(r != n1){
+        // an error, or a bad user address.
+        r = -1;
+        break;
+      }
+      tot += r;
+      room -= r;
+      done += r;
+      if(done == iov[i].iov_len){
+        i++;
+        done = 0;
+      }
+    }
+    iunlock(ip);
+    end_op();
+
+    if(r < 0)
+      return -1;
+  }
+  return tot;
+}
+
+// Read from file f.
+// If user_dst==1, then addr is a user virtual address;
+// otherwise, addr is a kernel address.
+static int
+fileread1(struct file *f, int user_dst, uint64 addr, int n)
 {
   int r = 0;
+  struct iovec iov;
 
   if(f->readable == 0)
     return -1;
 
   if(f->type == FD_PIPE){
-    r = piperead(f->pipe, addr, n);
+    r = piperead(f->pipe, user_dst, addr, n);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
-    r = devsw[f->major].read(1, addr, n);
+    r = devsw[f->major].read(user_dst, addr, n);
   } else if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
-      f->off += r;
-    iunlock(f->ip);
+    iov.iov_base = (void*)addr;
+    iov.iov_len = n;
+    r = inoderead(f->ip, user_dst, &iov, 1, &f->off, fileprivate(f));
   } else {
     panic("fileread");
   }
@@ -130,49 +237,27 @@ fileread(struct file *f, uint64 addr, int n)
 }
 
 // Write to file f.
-// addr is a user virtual address.
-int
-filewrite(struct file *f, uint64 addr, int n)
+// If user_src==1, then addr is a user virtual address;
+// otherwise, addr is a kernel address.
+static int
+filewrite1(struct file *f, int user_src, uint64 addr, int n)
 {
-  int r, ret = 0;
+  int ret = 0;
+  struct iovec iov;
 
   if(f->writable == 0)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, user_src, addr, n);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    ret = devsw[f->major].write(user_src, addr, n);
   } else if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
-        f->off += r;
-      iunlock(f->ip);
-      end_op();
-
-      if(r < 0)
-        break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
-    }
-    ret = (i == n ? n : -1);
+    iov.iov_base = (void*)addr;
+    iov.iov_len = n;
+    ret = inodewrite(f->ip, user_src, &iov, 1, &f->off);
   } else {
     panic("filewrite");
   }
@@ -180,3 +265,158 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Read from file f.
+// addr is a user virtual address.
+int
+fileread(struct file *f, uint64 addr, int n)
+{
+  return fileread1(f, 1, addr, n);
+}
+
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  return filewrite1(f, 1, addr, n);
+}
+
+// Read from file f into the user buffers described by iov.
+// A file is read under one ilock(); a pipe or device only
+// fills the first non-empty buffer, so that readv() never
+// blocks once some data has arrived.
+int
+filereadv(struct file *f, struct iovec *iov, int cnt)
+{
+  int i;
+
+  if(f->readable == 0)
+    return -1;
+  if(f->type == FD_INODE)
+    return inoderead(f->ip, 1, iov, cnt, &f->off, fileprivate(f));
+  for(i = 0; i < cnt; i++){
+    if(iov[i].iov_len > 0)
+      return fileread1(f, 1, (uint64)iov[i].iov_base, iov[i].iov_len);
+  }
+  return 0;
+}
+
+// Write the user buffers described by iov to file f.
+// Writes to a file are packed into as few log transactions
+// as the transaction size limit allows.
+int
+filewritev(struct file *f, struct iovec *iov, int cnt)
+{
+  int i, r, tot;
+
+  if(f->writable == 0)
+    return -1;
+  if(f->type == FD_INODE)
+    return inodewrite(f->ip, 1, iov, cnt, &f->off);
+  tot = 0;
+  for(i = 0; i < cnt; i++){
+    if((r = filewrite1(f, 1, (uint64)iov[i].iov_base, iov[i].iov_len)) < 0)
+      return tot > 0 ? tot : -1;
+    tot += r;
+    if(r != iov[i].iov_len)
+      break;
+  }
+  return tot;
+}
+
+// Read from file f at offset off, without using or
+// changing f->off. Only regular inode files have offsets.
+// addr is a user virtual address.
+int
+filepread(struct file *f, uint64 addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->readable == 0 || f->type != FD_INODE)
+    return -1;
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return inoderead(f->ip, 1, &iov, 1, &off, 1);
+}
+
+// Write to file f at offset off, without using or
+// changing f->off.
+// addr is a user virtual address.
+int
+filepwrite(struct file *f, uint64 addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->writable == 0 || f->type != FD_INODE)
+    return -1;
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return inodewrite(f->ip, 1, &iov, 1, &off);
+}
+
+// Move up to n bytes from fin to fout entirely inside the kernel,
+// e.g. from a file into a pipe, so that the data never makes a
+// round trip through user space. The data is staged a page at a
+// time; no lock is held across the read and the write, so a pipe
+// reader may freely touch the same file. Stops at end of file, or
+// after a short read from a pipe or device.
+// Returns the number of bytes moved, or -1 on error. If fout fails
+// part way through a chunk, a file fin is backed up to the first
+// byte not written; bytes read from a pipe or device can't be put
+// back, so reads from them are kept to what a pipe fout has room
+// for, and any loss is reported as -1 rather than a short count.
+int
+filesplice(struct file *fin, struct file *fout, int n)
+{
+  char *buf;
+  int r, w, m, tot, lost;
+
+  if(fin->readable == 0 || fout->writable == 0 || n < 0)
+    return -1;
+  if((buf = kalloc()) == 0)
+    return -1;
+
+  r = tot = lost = 0;
+  while(tot < n){
+    int n1 = n - tot;
+    if(n1 > PGSIZE)
+      n1 = PGSIZE;
+    // what is read from a pipe or device can't be put back
+    // if fout fails, so don't take more than a pipe fout has
+    // room for; its reader closing is the likely failure.
+    if(fin->type != FD_INODE && fout->type == FD_PIPE){
+      int room = pipespace(fout->pipe);
+      if(room < 1)
+        room = 1;
+      if(n1 > room)
+        n1 = room;
+    }
+    if((r = fileread1(fin, 0, (uint64)buf, n1)) <= 0)
+      break;
+    // a pipe or device may take a chunk a piece at a time.
+    for(w = 0; w < r; w += m){
+      if((m = filewrite1(fout, 0, (uint64)buf + w, r - w)) <= 0)
+        break;
+    }
+    tot += w;
+    if(w < r){
+      if(fin->type == FD_INODE){
+        ilock(fin->ip);
+        fin->off -= r - w;
+        iunlock(fin->ip);
+      } else {
+        lost = 1;
+      }
+      r = -1;
+      break;
+    }
+    if(r < n1)
+      break;
+  }
+  kfree(buf);
+
+  if(lost || (r < 0 && tot == 0))
+    return -1;
+  return tot;
+}
+
@@ -0,0 +1,232 @@
+//
+// I/O scheduler, between the buffer cache and the disk driver.
+//
+// There is one scheduler queue per disk virtqueue, and a hart
+// uses the queue of the virtqueue it submits to, so harts don't
+// contend for one lock or one in-flight budget.
+//
+// Requests wait in a queue sorted by block number. Each time
+// the driver can take another request on that queue, the
+// scheduler picks the first block at or after where the queue's
+// last request ended (a one-way elevator), and merges the run
+// of adjacent blocks that follows it into one disk request.
+// A request that has waited past its deadline goes first, so
+// that a stream of requests ahead of the elevator can't starve
+// the rest. Reads and writes each wait in arrival order on a
+// FIFO as well, so the oldest of each is at the FIFO's head.
+//
+// Requests only queue up when the driver already has
+// IOINFLIGHT requests from the queue, or when a caller such
+// as the log hands over many blocks at once with bwriten().
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "buf.h"
+#include "diskstat.h"
+
+#define RDEADLINE 1  // clock ticks a read may wait in the queue
+#define WDEADLINE 5  // clock ticks a write may wait
+
+struct ioqueue {
+  struct spinlock lock;
+  struct buf *queue;  // waiting requests, sorted, through qnext
+  struct buf *fifo[2];  // fifo[write]: the same, oldest first
+  struct buf *fifotail[2];
+  uint dev;           // the elevator: where the last request ended
+  uint pos;
+  int ninflight;      // requests the driver has from this queue
+
+  // counters for diskstat().
+  uint64 nblock;
+  uint64 nmerged;
+  uint64 nexpired;
+};
+
+// one for each virtqueue the driver may use.
+static struct ioqueue ioq[NCPU];
+
+void
+ioschedinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&ioq[i].lock, "iosched");
+}
+
+// does block (dev1, blockno1) come before (dev2, blockno2)?
+static int
+before(uint dev1, uint blockno1, uint dev2, uint blockno2)
+{
+  return dev1 < dev2 || (dev1 == dev2 && blockno1 < blockno2);
+}
+
+// add b to the queue, in order, and to the tail of its FIFO.
+static void
+enqueue(struct ioqueue *q, struct buf *b)
+{
+  struct buf **pp;
+
+  for(pp = &q->queue; *pp; pp = &(*pp)->qnext)
+    if(before(b->dev, b->blockno, (*pp)->dev, (*pp)->blockno))
+      break;
+  b->qnext = *pp;
+  *pp = b;
+
+  b->fnext = 0;
+  b->fprev = q->fifotail[b->write];
+  if(b->fprev)
+    b->fprev->fnext = b;
+  else
+    q->fifo[b->write] = b;
+  q->fifotail[b->write] = b;
+}
+
+// take b off its FIFO, as it leaves for the disk.
+static void
+fiforemove(struct ioqueue *q, struct buf *b)
+{
+  if(b->fprev)
+    b->fprev->fnext = b->fnext;
+  else
+    q->fifo[b->write] = b->fnext;
+  if(b->fnext)
+    b->fnext->fprev = b->fprev;
+  else
+    q->fifotail[b->write] = b->fprev;
+  b->fnext = b->fprev = 0;
+}
+
+// the oldest request that is past its deadline, or 0.
+// only the FIFO heads can be the oldest.
+static struct buf*
+expired(struct ioqueue *q)
+{
+  struct buf *b = 0, *h;
+
+  for(int w = 0; w < 2; w++){
+    h = q->fifo[w];
+    if(h && (int)(ticks - h->deadline) > 0 &&
+       (b == 0 || (int)(h->deadline - b->deadline) < 0))
+      b = h;
+  }
+  return b;
+}
+
+// start as many of q's requests as the driver may have.
+// caller holds q->lock.
+static void
+dispatch(struct ioqueue *q)
+{
+  struct buf **pp, **start, *b, *last;
+  int n;
+
+  while(q->ninflight < IOINFLIGHT && q->queue){
+    if((b = expired(q)) != 0){
+      for(start = &q->queue; *start != b; start = &(*start)->qnext)
+        ;
+      q->nexpired++;
+    } else {
+      // otherwise the next one on the elevator's way,
+      // or back to the start of the disk.
+      for(pp = &q->queue; *pp; pp = &(*pp)->qnext)
+        if(!before((*pp)->dev, (*pp)->blockno, q->dev, q->pos))
+          break;
+      start = *pp ? pp : &q->queue;
+    }
+
+    // take the run of adjacent blocks that starts there.
+    b = last = *start;
+    fiforemove(q, b);
+    for(n = 1; n < IOMAXMERGE; n++){
+      if(last->qnext == 0 || last->qnext->dev != b->dev ||
+         last->qnext->blockno != last->blockno + 1 ||
+         last->qnext->write != b->write)
+        break;
+      last = last->qnext;
+      fiforemove(q, last);
+    }
+    *start = last->qnext;
+    last->qnext = 0;
+
+    q->nmerged += n - 1;
+    q->dev = b->dev;
+    q->pos = last->blockno + 1;
+    q->ninflight++;
+    virtio_disk_start(q - ioq, b, n, b->write);
+  }
+}
+
+// Read or write the n locked bufs in bs, and wait
+// until the disk has done them all.
+void
+iosched_rw(struct buf **bs, int n, int write)
+{
+  struct ioqueue *q;
+  struct buf *b;
+  int i;
+
+  // use the queue of this hart's virtqueue.
+  push_off();
+  q = &ioq[cpuid() % virtio_disk_nqueue()];
+  pop_off();
+
+  acquire(&q->lock);
+  for(i = 0; i < n; i++){
+    b = bs[i];
+    b->disk = 1;
+    b->write = write;
+    b->deadline = ticks + (write ? WDEADLINE : RDEADLINE);
+    enqueue(q, b);
+  }
+  q->nblock += n;
+  dispatch(q);
+
+  // Wait for iosched_done() to say the requests have finished.
+  for(i = 0; i < n; i++){
+    while(bs[i]->disk)
+      sleep(bs[i], &q->lock);
+  }
+  release(&q->lock);
+}
+
+// The driver has finished the request on virtqueue qid
+// for b and the blocks that follow it through qnext.
+void
+iosched_done(int qid, struct buf *b)
+{
+  struct ioqueue *q = &ioq[qid];
+
+  acquire(&q->lock);
+  for(; b; b = b->qnext){
+    b->disk = 0;   // disk is done with buf
+    wakeup(b);
+  }
+  q->ninflight--;
+  dispatch(q);
+  release(&q->lock);
+}
+
+// copy the scheduler's and driver's counters
+// to user address addr.
+int
+diskstat(uint64 addr)
+{
+  struct diskstat st;
+  struct ioqueue *q;
+
+  memset(&st, 0, sizeof(st));
+  for(q = ioq; q < ioq + NCPU; q++){
+    acquire(&q->lock);
+    st.nblock += q->nblock;
+    st.nmerged += q->nmerged;
+    st.nexpired += q->nexpired;
+    release(&q->lock);
+  }
+  virtio_disk_stat(&st);
+  return either_copyout(1, addr, &st, sizeof(st));
+}
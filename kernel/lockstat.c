@@ -0,0 +1,93 @@
+// Lock contention profiling.
+//
+// Every lock with a given name shares one struct lockstat,
+// found by initlock() and initsleeplock(). acquire() and
+// release() update the current CPU's counters while holding
+// the lock, so no atomic operations are needed. lockstat()
+// sums them up for user space.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "rusage.h"
+#include "proc.h"
+#include "defs.h"
+#include "lockstat.h"
+
+#define NLOCKSTAT 64
+
+static struct lockstat stats[NLOCKSTAT];
+static int nstats;
+
+// initlock() runs before there is anything to guard this with,
+// and must not recurse into itself, so use a bare flag.
+static uint statslock;
+
+// Return the counters for locks named name, of the given
+// kind, allocating them if need be. Returns 0 if the table
+// is full, in which case the lock isn't profiled.
+struct lockstat*
+lockstatfor(char *name, int sleep)
+{
+  struct lockstat *st;
+
+  push_off();
+  while(__sync_lock_test_and_set(&statslock, 1) != 0)
+    ;
+  __sync_synchronize();
+
+  for(st = stats; st < stats + nstats; st++){
+    if(st->sleep == sleep && strncmp(st->name, name, 16) == 0)
+      goto found;
+  }
+  if(nstats == NLOCKSTAT){
+    st = 0;
+    goto found;
+  }
+  st = &stats[nstats++];
+  st->name = name;
+  st->sleep = sleep;
+
+found:
+  __sync_synchronize();
+  __sync_lock_release(&statslock);
+  pop_off();
+  return st;
+}
+
+// Copy the summed counters of up to n names to the user
+// array of struct lockinfo at addr, and clear them if reset
+// is set. Returns the number copied, or -1.
+int
+lockstatcopy(uint64 addr, int n, int reset)
+{
+  struct lockinfo li;
+  struct lockstat *st;
+  int i, c, nst;
+
+  nst = *(volatile int *)&nstats;
+  for(i = 0; i < nst && i < n; i++){
+    st = &stats[i];
+    memset(&li, 0, sizeof(li));
+    safestrcpy(li.name, st->name, sizeof(li.name));
+    li.sleep = st->sleep;
+    for(c = 0; c < NCPU; c++){
+      li.nacquire += st->cpu[c].nacquire;
+      li.ncontend += st->cpu[c].ncontend;
+      li.nspin += st->cpu[c].nspin;
+      li.nsleep += st->cpu[c].nsleep;
+      li.holdcycles += st->cpu[c].holdcycles;
+    }
+    if(copyout(myproc()->pagetable, addr + i*sizeof(li), (char*)&li, sizeof(li)) < 0)
+      return -1;
+  }
+  if(reset){
+    // other CPUs may be updating their counters; a count
+    // that slips through the reset does no harm.
+    for(i = 0; i < nst; i++)
+      memset(stats[i].cpu, 0, sizeof(stats[i].cpu));
+  }
+  return i;
+}
@@ -0,0 +1,13 @@
+// Lock contention counters, as returned by lockstat().
+// Both the kernel and user programs use this header file.
+// There is one entry for all the locks with the same name.
+struct lockinfo {
+  char name[16];
+  int sleep;          // 1 for sleep locks, 0 for spinlocks
+  uint64 nacquire;    // acquisitions
+  uint64 ncontend;    // acquisitions that had to wait
+  uint64 nspin;       // polls while waiting
+  uint64 nsleep;      // sleeps while waiting (sleep locks)
+  uint64 holdcycles;  // cycles held exclusively; for sleep
+                      // locks, ticks of the r_time() clock
+};
@@ -4,6 +4,8 @@
 #include "param.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "rusage.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
 
@@ -19,106 +21,357 @@
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
 // But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// sleeps until the flusher has committed the transaction
+// and emptied the log.
+//
+// end_op() doesn't commit. The transaction stays open, and
+// later system calls add to it, until the flusher commits it
+// COMMITTICKS after it began or when it grows too big for
+// the log, or until log_sync() commits it for fsync() or
+// sync(). So a system call that returns has made changes
+// that a crash may lose, but never half of them.
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
-//   block A
-//   block B
-//   block C
-//   ...
-// Log appends are synchronous.
-
-// Contents of the header block, used for both the on-disk header block
-// and to keep track in memory of logged block# before commit.
+//   start block, saying where in the ring recovery starts
+//   ring of transactions, each of them:
+//     commit record, with a sequence number, block #s for
+//       block A, B, C, ..., and a checksum
+//     block A
+//     block B
+//     block C
+//     ...
+//
+// Committing appends the commit record and the blocks to the
+// ring all at once, and waits for the disk just once. Recovery
+// replays transactions from the start block on, for as long as
+// each has the next sequence number and a checksum that
+// matches its blocks; a transaction that didn't reach the disk
+// in full doesn't. So there is no header to write afterwards,
+// and none to clear.
+//
+// Committed blocks aren't written to their home locations
+// straight away. They stay pinned in the buffer cache, and
+// later transactions that change them again just log them
+// again. The flusher kernel thread writes them home, all at
+// once, when the ring fills up or FLUSHTICKS after a commit,
+// and then moves the start block past them. So a block that
+// many transactions change, such as a bitmap or inode block,
+// is written home only once.
+//
+// A block freed by the transaction that logged it need not
+// be written at all: log_cancel() drops it from the
+// transaction, and revokes any copy that earlier
+// transactions committed, so the flusher won't write it.
+// Recovery may still replay old copies of a freed block,
+// which is harmless, as nothing reads a free block.
+
+#define COMMITTICKS 5  // clock ticks a transaction may stay open
+#define FLUSHTICKS 30  // clock ticks committed blocks may wait
+#define NLOGHASH   64  // buckets in a logindex; a power of two
+#define LOGMAGIC   0x10c5ea1  // marks a start block or commit record
+
+// Block numbers, used in memory for the transaction and for
+// the committed blocks.
 struct logheader {
   int n;
   int block[LOGSIZE];
 };
 
+// The log's first block.
+struct logstart {
+  uint magic;
+  uint tail;  // ring position of the oldest transaction to replay
+  uint seq;   // and its sequence number
+};
+
+// The first block of each transaction in the ring.
+struct logrecord {
+  uint magic;
+  uint seq;   // one more than the previous transaction's
+  uint sum;   // checksum of seq, n, block[], and the blocks
+  int n;
+  int block[LOGSIZE];
+};
+
+// A hash index from block number to position in a logheader's
+// block[], so that finding a block in the transaction or among
+// the committed blocks doesn't take a search of either.
+struct logindex {
+  short head[NLOGHASH];  // first position in each bucket, or -1
+  short next[LOGSIZE];   // next position in the same bucket, or -1
+};
+
 struct log {
   struct spinlock lock;
   int start;
   int size;
+  int nslot;       // how many blocks the ring holds.
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int committing;  // in commit() or install_trans(), please wait.
+  int flushing;    // begin_op() wants the flusher to empty the log.
+  int syncing;     // how many are waiting in log_sync().
   int dev;
-  struct logheader lh;
+  struct logheader lh;   // the transaction's blocks.
+  struct logindex lhindex;
+  struct buf *lhbuf[LOGSIZE];
+  struct logheader disk; // committed blocks not yet written home.
+  struct logindex diskindex;
+  struct buf *diskbuf[LOGSIZE];
+  int revoke[LOGSIZE];   // freed committed blocks, to drop at commit.
+  int nrevoke;
+  uint seq;        // the next transaction's sequence number.
+  int tail;        // ring position of the oldest transaction.
+  int head;        // ring position for the next transaction.
+  int used;        // ring blocks from tail to head.
+  uint opentime;   // when the transaction logged its first block.
+  uint committime; // when the oldest committed block was committed.
 };
 struct log log;
 
 static void recover_from_log(void);
+static void install_trans(void);
+static void write_head(void);
 static void commit();
+static void flusher(void);
+
+static void
+idxclear(struct logindex *ix)
+{
+  memset(ix->head, 0xff, sizeof(ix->head)); // all -1
+}
+
+// The position of blockno in h, or -1.
+static int
+idxfind(struct logindex *ix, struct logheader *h, uint blockno)
+{
+  int i;
+
+  for (i = ix->head[blockno % NLOGHASH]; i >= 0; i = ix->next[i]) {
+    if (h->block[i] == blockno)
+      return i;
+  }
+  return -1;
+}
+
+// Index h->block[i].
+static void
+idxadd(struct logindex *ix, struct logheader *h, int i)
+{
+  short *hp = &ix->head[(uint)h->block[i] % NLOGHASH];
+
+  ix->next[i] = *hp;
+  *hp = i;
+}
+
+// Stop indexing h->block[i].
+static void
+idxdel(struct logindex *ix, struct logheader *h, int i)
+{
+  short *pp;
+
+  for (pp = &ix->head[(uint)h->block[i] % NLOGHASH]; *pp != i; pp = &ix->next[*pp])
+    if (*pp < 0)
+      panic("idxdel");
+  *pp = ix->next[i];
+}
+
+// Add blockno and its buf to the end of h.
+static void
+listadd(struct logheader *h, struct logindex *ix, struct buf **bufs,
+        uint blockno, struct buf *b)
+{
+  int i = h->n++;
+
+  h->block[i] = blockno;
+  bufs[i] = b;
+  idxadd(ix, h, i);
+}
+
+// Remove h->block[i], moving the last block into its place.
+static void
+listdel(struct logheader *h, struct logindex *ix, struct buf **bufs, int i)
+{
+  int last;
+
+  idxdel(ix, h, i);
+  last = --h->n;
+  if (i != last) {
+    idxdel(ix, h, last);
+    h->block[i] = h->block[last];
+    bufs[i] = bufs[last];
+    idxadd(ix, h, i);
+  }
+}
+
+// The disk block at ring position pos.
+static uint
+ringblock(int pos)
+{
+  return log.start + 1 + pos % log.nslot;
+}
+
+// Fold n bytes at p into checksum h (32-bit FNV-1a,
+// a word at a time). n must be a multiple of 4.
+static uint
+logsum(uint h, void *p, int n)
+{
+  uint *w = p;
+
+  for (; n > 0; n -= 4)
+    h = (h ^ *w++) * 16777619;
+  return h;
+}
+
+// The checksum of r's header fields; fold r's blocks in after.
+static uint
+recordsum(struct logrecord *r)
+{
+  uint h = 2166136261;
+
+  h = logsum(h, &r->seq, sizeof(r->seq));
+  h = logsum(h, &r->n, sizeof(r->n));
+  return logsum(h, r->block, r->n * sizeof(r->block[0]));
+}
 
 void
 initlog(int dev, struct superblock *sb)
 {
-  if (sizeof(struct logheader) >= BSIZE)
-    panic("initlog: too big logheader");
+  if (sizeof(struct logrecord) >= BSIZE)
+    panic("initlog: too big logrecord");
 
   initlock(&log.lock, "log");
   log.start = sb->logstart;
   log.size = sb->nlog;
+  log.nslot = log.size - 1;
+  if(log.nslot > LOGSIZE)
+    log.nslot = LOGSIZE;
   log.dev = dev;
+  idxclear(&log.lhindex);
+  idxclear(&log.diskindex);
   recover_from_log();
+  kthread(flusher, "flusher");
 }
 
-// Copy committed blocks from log to their home location
+// Write committed blocks to their home locations, and move
+// the start block past the transactions that held them, so
+// that recovery won't replay them. The pinned cache blocks
+// hold the data. They all go to the disk together, so the
+// I/O scheduler can write them in block order.
 static void
 install_trans(void)
 {
-  int tail;
+  struct buf *dbuf[LOGSIZE];
+  int i, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    bunpin(dbuf);
-    brelse(lbuf);
-    brelse(dbuf);
+  if (log.used == 0)
+    return;
+  n = log.disk.n;
+  for (i = 0; i < n; i++)
+    dbuf[i] = bread(log.dev, log.disk.block[i]); // read dst
+  bwriten(dbuf, n);  // write dst to disk
+  for (i = 0; i < n; i++) {
+    bunpin(dbuf[i]);
+    brelse(dbuf[i]);
   }
+
+  log.disk.n = 0;
+  idxclear(&log.diskindex);
+  log.tail = log.head;
+  log.used = 0;
+  write_head(); // Erase the installed transactions from the log
 }
 
-// Read the log header from disk into the in-memory log header
+// Read the log's start block, to find where recovery starts.
 static void
 read_head(void)
 {
   struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
-  int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
+  struct logstart *ls = (struct logstart *) (buf->data);
+
+  if (ls->magic == LOGMAGIC) {
+    log.tail = ls->tail % log.nslot;
+    log.seq = ls->seq;
+  } else {
+    // a new file system.
+    log.tail = 0;
+    log.seq = 1;
   }
+  log.head = log.tail;
+  log.used = 0;
   brelse(buf);
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
+// Write the log's start block.
 static void
 write_head(void)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *hb = (struct logheader *) (buf->data);
-  int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
-  }
+  struct buf *buf = bnew(log.dev, log.start);
+  struct logstart *ls = (struct logstart *) (buf->data);
+
+  memset(buf->data, 0, BSIZE);
+  ls->magic = LOGMAGIC;
+  ls->tail = log.tail;
+  ls->seq = log.seq;
   bwrite(buf);
   brelse(buf);
 }
 
+// Is the transaction whose record is r, at log.head, the next
+// one, and did all of it reach the disk?
+static int
+valid_record(struct logrecord *r)
+{
+  struct buf *lbuf;
+  uint sum;
+  int i;
+
+  if (r->magic != LOGMAGIC || r->seq != log.seq ||
+     r->n <= 0 || r->n + 1 > log.nslot - log.used)
+    return 0;
+  sum = recordsum(r);
+  for (i = 0; i < r->n; i++) {
+    lbuf = bread(log.dev, ringblock(log.head + 1 + i));
+    sum = logsum(sum, lbuf->data, BSIZE);
+    brelse(lbuf);
+  }
+  return sum == r->sum;
+}
+
+// Replay the transactions in the ring into the buffer cache,
+// as if they had just committed, and then install them.
 static void
 recover_from_log(void)
 {
+  struct buf *rbuf, *lbuf, *dbuf;
+  struct logrecord *r;
+  int i;
+
   read_head();
+  while (1) {
+    rbuf = bread(log.dev, ringblock(log.head));
+    r = (struct logrecord *) (rbuf->data);
+    if (!valid_record(r)) {
+      brelse(rbuf);
+      break;
+    }
+    for (i = 0; i < r->n; i++) {
+      lbuf = bread(log.dev, ringblock(log.head + 1 + i)); // read log block
+      dbuf = bread(log.dev, r->block[i]); // read dst
+      memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+      if (idxfind(&log.diskindex, &log.disk, r->block[i]) < 0) {
+        bpin(dbuf);
+        listadd(&log.disk, &log.diskindex, log.diskbuf, r->block[i], dbuf);
+      }
+      brelse(lbuf);
+      brelse(dbuf);
+    }
+    log.head = (log.head + r->n + 1) % log.nslot;
+    log.used += r->n + 1;
+    log.seq++;
+    brelse(rbuf);
+  }
   install_trans(); // if committed, copy from log to disk
-  log.lh.n = 0;
-  write_head(); // clear the log
 }
 
 // called at the start of each FS system call.
@@ -127,10 +380,16 @@ begin_op(void)
 {
   acquire(&log.lock);
   while(1){
-    if(log.committing){
+    if(log.committing || log.flushing || log.syncing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
-      // this op might exhaust log space; wait for commit.
+    } else if(log.used + log.lh.n + 1 + (log.outstanding+1)*MAXOPBLOCKS > log.nslot){
+      // this op might exhaust log space; once the running
+      // ones finish, ask the flusher, which sleeps on ticks,
+      // to commit and empty the log.
+      if(log.outstanding == 0){
+        log.flushing = 1;
+        wakeup(&ticks);
+      }
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
@@ -141,63 +400,168 @@ begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// leaves the transaction open for later ones.
 void
 end_op(void)
 {
-  int do_commit = 0;
-
   acquire(&log.lock);
   log.outstanding -= 1;
   if(log.committing)
     panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
-  } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
-  }
+  // begin_op() may be waiting for log space, and
+  // decrementing log.outstanding has decreased the amount
+  // of reserved space; or the flusher or log_sync() may be
+  // waiting for the FS system calls to finish.
+  wakeup(&log);
   release(&log.lock);
+}
 
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
-  }
+// Commit the transaction, and wait until it is on disk.
+// For fsync() and sync(); not called in a transaction.
+void
+log_sync(void)
+{
+  acquire(&log.lock);
+  log.syncing += 1;  // keep new FS system calls out
+  while(log.outstanding > 0 || log.committing)
+    sleep(&log, &log.lock);
+  log.syncing -= 1;
+  log.committing = 1;
+  release(&log.lock);
+
+  // call commit w/o holding locks, since not allowed
+  // to sleep with locks.
+  commit();
+
+  acquire(&log.lock);
+  log.committing = 0;
+  wakeup(&log);
+  release(&log.lock);
 }
 
-// Copy modified blocks from cache to log.
+// Append the transaction to the ring: its commit record and
+// then copies of its blocks, all handed to the disk at once.
+// This is the true point at which the transaction commits.
 static void
 write_log(void)
 {
-  int tail;
+  struct buf *to[LOGSIZE+1];
+  struct logrecord *r;
+  int tail, n;
+  uint sum;
+
+  n = log.lh.n;
+  to[0] = bnew(log.dev, ringblock(log.head)); // commit record
+  memset(to[0]->data, 0, BSIZE);
+  r = (struct logrecord *) (to[0]->data);
+  r->magic = LOGMAGIC;
+  r->seq = log.seq;
+  r->n = n;
+  for (tail = 0; tail < n; tail++)
+    r->block[tail] = log.lh.block[tail];
+  sum = recordsum(r);
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
+  for (tail = 0; tail < n; tail++) {
+    to[tail+1] = bnew(log.dev, ringblock(log.head + 1 + tail)); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    memmove(to[tail+1]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
+    sum = logsum(sum, to[tail+1]->data, BSIZE);
   }
+  r->sum = sum;
+
+  bwriten(to, n+1);  // write the log
+  for (tail = 0; tail <= n; tail++)
+    brelse(to[tail]);
+
+  log.head = (log.head + n + 1) % log.nslot;
+  log.used += n + 1;
+  log.seq++;
 }
 
 static void
 commit()
 {
+  int tail, i;
+
   if (log.lh.n > 0) {
     write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    // the blocks join the committed ones, pinned until the
+    // flusher writes them home.
+    for (tail = 0; tail < log.lh.n; tail++) {
+      if (idxfind(&log.diskindex, &log.disk, log.lh.block[tail]) >= 0)
+        continue;
+      if (log.disk.n == 0)
+        log.committime = ticks;
+      listadd(&log.disk, &log.diskindex, log.diskbuf,
+              log.lh.block[tail], log.lhbuf[tail]);
+    }
+  }
+  for (i = 0; i < log.nrevoke; i++) {
+    int j = idxfind(&log.diskindex, &log.disk, log.revoke[i]);
+    struct buf *b = log.diskbuf[j];
+    listdel(&log.disk, &log.diskindex, log.diskbuf, j);
+    bunpin(b);
+  }
+  log.nrevoke = 0;
+  log.lh.n = 0;
+  idxclear(&log.lhindex);
+}
+
+// Is it time for the flusher to commit or install?
+static int
+flushdue(void)
+{
+  return log.flushing ||
+         (log.lh.n > 0 && ticks - log.opentime >= COMMITTICKS) ||
+         (log.used > 0 && ticks - log.committime >= FLUSHTICKS);
+}
+
+// The flusher kernel thread. It waits until the log is full,
+// the transaction has been open COMMITTICKS, or committed
+// blocks have waited FLUSHTICKS. Then it keeps new FS system
+// calls out until the current ones have finished, commits the
+// transaction, and writes the committed blocks home if the
+// log is short of space or they have waited long enough.
+static void
+flusher(void)
+{
+  int install;
+
+  acquire(&log.lock);
+  while(1){
+    while(!flushdue())
+      sleep(&ticks, &log.lock);
+    log.flushing = 1;
+    while(log.outstanding > 0 || log.committing)
+      sleep(&log, &log.lock);
+    log.committing = 1;
+    release(&log.lock);
+
+    commit();
+    install = log.used + 1 + MAXOPBLOCKS > log.nslot ||
+              (log.used > 0 && ticks - log.committime >= FLUSHTICKS);
+    if(install)
+      install_trans();
+
+    acquire(&log.lock);
+    log.committing = 0;
+    log.flushing = 0;
+    wakeup(&log);
+  }
+}
+
+// Don't revoke blockno after all.
+static void
+unrevoke(uint blockno)
+{
+  int i;
+
+  for (i = 0; i < log.nrevoke; i++) {
+    if (log.revoke[i] == blockno) {
+      log.revoke[i] = log.revoke[--log.nrevoke];
+      return;
+    }
   }
 }
 
@@ -213,23 +577,41 @@ commit()
 void
 log_write(struct buf *b)
 {
-  int i;
-
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (log.used + log.lh.n + 1 >= log.nslot)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
+  myproc()->ru.oublock++;
 
   acquire(&log.lock);
-  for (i = 0; i < log.lh.n; i++) {
-    if (log.lh.block[i] == b->blockno)   // log absorbtion
-      break;
-  }
-  log.lh.block[i] = b->blockno;
-  if (i == log.lh.n) {  // Add new block to log?
-    bpin(b);
-    log.lh.n++;
+  if (idxfind(&log.lhindex, &log.lh, b->blockno) < 0) {  // log absorbtion
+    if (log.lh.n == 0)
+      log.opentime = ticks;
+    listadd(&log.lh, &log.lhindex, log.lhbuf, b->blockno, b);
+    if (idxfind(&log.diskindex, &log.disk, b->blockno) < 0)
+      bpin(b);  // a committed block is still pinned
+    else
+      unrevoke(b->blockno);  // freed and allocated again
   }
   release(&log.lock);
 }
 
+// The transaction has freed blockno, so drop it from the
+// transaction, and revoke the copy that an earlier
+// transaction committed, if any. Caller is in a transaction.
+void
+log_cancel(uint blockno)
+{
+  int i, committed;
+
+  acquire(&log.lock);
+  committed = idxfind(&log.diskindex, &log.disk, blockno) >= 0;
+  if ((i = idxfind(&log.lhindex, &log.lh, blockno)) >= 0) {
+    if (!committed)
+      bunpin(log.lhbuf[i]);
+    listdel(&log.lh, &log.lhindex, log.lhbuf, i);
+  }
+  if (committed)
+    log.revoke[log.nrevoke++] = blockno;
+  release(&log.lock);
+}
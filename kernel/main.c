@@ -22,9 +22,12 @@ main()
     procinit();      // process table
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
+    profinit();      // sampling profiler
+    traceinit();     // tracepoints
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
+    ioschedinit();   // disk request queue
     iinit();         // inode cache
     fileinit();      // file table
     virtio_disk_init(); // emulated hard disk
@@ -51,9 +51,16 @@
 // in both user and kernel space.
 #define TRAMPOLINE (MAXVA - PGSIZE)
 
-// map kernel stacks beneath the trampoline,
-// each surrounded by invalid guard pages.
-#define KSTACK(p) (TRAMPOLINE - ((p)+1)* 2*PGSIZE)
+// user memory lies below the PLIC, so that a process's
+// kernel page table can map it next to the devices above.
+// the CLINT, which only machine mode uses, is left out of
+// process kernel page tables.
+#define MAXUVA PLIC
+
+// each process's kernel stack, mapped only in its own kernel
+// page table, at the top of the first gigabyte, above the
+// devices. the page below it is left unmapped as a guard.
+#define KSTACK (0x40000000L - PGSIZE)
 
 // User memory layout.
 // Address zero first:
@@ -62,6 +69,21 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   USHARED (read-only, the same page in every process)
+//   USYSCALL (read-only, p->usyscall)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// user code reads these pages, rather than making a
+// system call, for values the kernel keeps up to date.
+#define USYSCALL (TRAPFRAME - PGSIZE)
+#define USHARED (USYSCALL - PGSIZE)
+
+struct usyscall {
+  int pid;      // Process ID
+};
+
+struct ushared {
+  uint ticks;   // clock ticks since boot
+};
@@ -3,6 +3,7 @@
 #include "defs.h"
 #include "param.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 #include "fs.h"
 #include "sleeplock.h"
@@ -73,15 +74,18 @@ pipeclose(struct pipe *pi, int writable)
     release(&pi->lock);
 }
 
+// Write n bytes from addr into the pipe.
+// If user_src==1, then addr is a user virtual address;
+// otherwise, addr is a kernel address.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipewrite(struct pipe *pi, int user_src, uint64 addr, int n)
 {
-  int i;
-  char ch;
+  int i, m;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
-  for(i = 0; i < n; i++){
+  i = 0;
+  while(i < n){
     while(pi->nwrite == pi->nread + PIPESIZE){  //DOC: pipewrite-full
       if(pi->readopen == 0 || pr->killed){
         release(&pi->lock);
@@ -90,21 +94,43 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     }
-    if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+    // copy as much as fits before the ring wraps.
+    m = n - i;
+    if(m > pi->nread + PIPESIZE - pi->nwrite)
+      m = pi->nread + PIPESIZE - pi->nwrite;
+    if(m > PIPESIZE - pi->nwrite % PIPESIZE)
+      m = PIPESIZE - pi->nwrite % PIPESIZE;
+    if(either_copyin(&pi->data[pi->nwrite % PIPESIZE], user_src, addr + i, m) == -1)
       break;
-    pi->data[pi->nwrite++ % PIPESIZE] = ch;
+    pi->nwrite += m;
+    i += m;
   }
+  pr->ru.piped += i;
   wakeup(&pi->nread);
   release(&pi->lock);
   return i;
 }
 
+// How many bytes can be written to the pipe without waiting?
 int
-piperead(struct pipe *pi, uint64 addr, int n)
+pipespace(struct pipe *pi)
 {
-  int i;
+  int n;
+
+  acquire(&pi->lock);
+  n = PIPESIZE - (pi->nwrite - pi->nread);
+  release(&pi->lock);
+  return n;
+}
+
+// Read up to n bytes from the pipe into addr.
+// If user_dst==1, then addr is a user virtual address;
+// otherwise, addr is a kernel address.
+int
+piperead(struct pipe *pi, int user_dst, uint64 addr, int n)
+{
+  int i, m;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
@@ -114,12 +140,17 @@ piperead(struct pipe *pi, uint64 addr, int n)
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  i = 0;
+  while(i < n && pi->nread != pi->nwrite){  //DOC: piperead-copy
+    m = n - i;
+    if(m > pi->nwrite - pi->nread)
+      m = pi->nwrite - pi->nread;
+    if(m > PIPESIZE - pi->nread % PIPESIZE)
+      m = PIPESIZE - pi->nread % PIPESIZE;
+    if(either_copyout(user_dst, addr + i, &pi->data[pi->nread % PIPESIZE], m) == -1)
       break;
+    pi->nread += m;
+    i += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
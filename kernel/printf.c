@@ -13,20 +13,54 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "defs.h"
+#include "rusage.h"
 #include "proc.h"
 
 volatile int panicked = 0;
 
-// lock to avoid interleaving concurrent printf's.
+// set by panic(): print synchronously from then on.
+static volatile int panicking = 0;
+
+// printf() writes each message into the current CPU's log
+// ring, with interrupts off, and then asks the UART to send
+// it. klogmove() moves complete messages from the CPU rings
+// to klog, from which the UART sends them as it becomes
+// ready and which dmesg() reads. Only the CPU writes its
+// ring's w and e, and only klogmove(), holding klog.lock,
+// writes r, so printf() takes no lock. A message that
+// doesn't fit in the ring is cut short.
+#define CPULOGSIZE 1024
+#define KLOGSIZE   16384
+
+static struct cpulog {
+  char buf[CPULOGSIZE];
+  uint r;     // next byte to move to klog
+  uint w;     // end of the complete messages
+  uint e;     // end of the message being printed
+} __attribute__((aligned(64))) cpulogs[NCPU];
+
 static struct {
   struct spinlock lock;
-  int locking;
-} pr;
+  char buf[KLOGSIZE];
+  uint64 w;   // bytes ever logged
+  uint64 tx;  // bytes handed to the UART
+} klog;
 
 static char digits[] = "0123456789abcdef";
 
+// Add c to the message l is printing,
+// or print it right away if l is 0.
 static void
-printint(int xx, int base, int sign)
+putch(struct cpulog *l, int c)
+{
+  if(l == 0)
+    consputc(c);
+  else if(l->e - *(volatile uint*)&l->r < CPULOGSIZE)
+    l->buf[l->e++ % CPULOGSIZE] = c;
+}
+
+static void
+printint(struct cpulog *l, int xx, int base, int sign)
 {
   char buf[16];
   int i;
@@ -46,17 +80,17 @@ printint(int xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    putch(l, buf[i]);
 }
 
 static void
-printptr(uint64 x)
+printptr(struct cpulog *l, uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  putch(l, '0');
+  putch(l, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putch(l, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the console. only understands %d, %x, %p, %s.
@@ -64,20 +98,22 @@ void
 printf(char *fmt, ...)
 {
   va_list ap;
-  int i, c, locking;
+  int i, c;
   char *s;
-
-  locking = pr.locking;
-  if(locking)
-    acquire(&pr.lock);
+  struct cpulog *l;
 
   if (fmt == 0)
     panic("null fmt");
 
+  push_off();
+  l = panicking ? 0 : &cpulogs[cpuid()];
+  if(l)
+    l->e = l->w;
+
   va_start(ap, fmt);
   for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
     if(c != '%'){
-      consputc(c);
+      putch(l, c);
       continue;
     }
     c = fmt[++i] & 0xff;
@@ -85,39 +121,144 @@ printf(char *fmt, ...)
       break;
     switch(c){
     case 'd':
-      printint(va_arg(ap, int), 10, 1);
+      printint(l, va_arg(ap, int), 10, 1);
       break;
     case 'x':
-      printint(va_arg(ap, int), 16, 1);
+      printint(l, va_arg(ap, int), 16, 1);
       break;
     case 'p':
-      printptr(va_arg(ap, uint64));
+      printptr(l, va_arg(ap, uint64));
       break;
     case 's':
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        putch(l, *s);
       break;
     case '%':
-      consputc('%');
+      putch(l, '%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      putch(l, '%');
+      putch(l, c);
       break;
     }
   }
 
-  if(locking)
-    release(&pr.lock);
+  if(l){
+    // the message must be complete before klogmove() sees it.
+    __sync_synchronize();
+    l->w = l->e;
+  }
+  pop_off();
+
+  if(l)
+    uartkick();
+}
+
+// Move complete messages from the CPU rings to klog.
+// Caller must hold klog.lock.
+static void
+klogmove(void)
+{
+  struct cpulog *l;
+  uint r, w;
+
+  for(l = cpulogs; l < cpulogs + NCPU; l++){
+    r = l->r;
+    w = *(volatile uint*)&l->w;
+    __sync_synchronize();
+    for(; r != w; r++)
+      klog.buf[klog.w++ % KLOGSIZE] = l->buf[r % CPULOGSIZE];
+    // done reading before the CPU may reuse the space.
+    __sync_synchronize();
+    l->r = r;
+  }
+}
+
+// Copy up to n bytes of kernel output that the UART
+// hasn't sent yet to dst. Returns the number copied.
+// If the UART has fallen more than KLOGSIZE bytes behind,
+// it skips the oldest output.
+int
+klogtx(char *dst, int n)
+{
+  int i;
+
+  acquire(&klog.lock);
+  klogmove();
+  if(klog.w - klog.tx > KLOGSIZE)
+    klog.tx = klog.w - KLOGSIZE;
+  for(i = 0; i < n && klog.tx < klog.w; i++)
+    dst[i] = klog.buf[klog.tx++ % KLOGSIZE];
+  release(&klog.lock);
+  return i;
+}
+
+// Copy the most recent n bytes of kernel output, or as
+// many as klog holds, to the user address addr.
+// Returns the number of bytes copied, or -1.
+int
+dmesg(uint64 addr, int n)
+{
+  char buf[128];
+  uint64 start;
+  int i, m, tot;
+
+  if(n < 0)
+    return -1;
+  acquire(&klog.lock);
+  klogmove();
+  if(n > KLOGSIZE)
+    n = KLOGSIZE;
+  if(n > klog.w)
+    n = klog.w;
+  start = klog.w - n;
+  release(&klog.lock);
+
+  for(tot = 0; tot < n; tot += m){
+    m = n - tot;
+    if(m > sizeof(buf))
+      m = sizeof(buf);
+    // output printed meanwhile may overwrite the oldest
+    // bytes; that does no harm.
+    acquire(&klog.lock);
+    for(i = 0; i < m; i++)
+      buf[i] = klog.buf[(start + tot + i) % KLOGSIZE];
+    release(&klog.lock);
+    if(copyout(myproc()->pagetable, addr + tot, buf, m) < 0)
+      return -1;
+  }
+  return n;
+}
+
+// Print the output that the UART hasn't sent yet,
+// synchronously and without locks, for panic().
+static void
+klogflush(void)
+{
+  struct cpulog *l;
+  uint r;
+
+  if(klog.w - klog.tx > KLOGSIZE)
+    klog.tx = klog.w - KLOGSIZE;
+  for(; klog.tx < klog.w; klog.tx++)
+    consputc(klog.buf[klog.tx % KLOGSIZE]);
+  for(l = cpulogs; l < cpulogs + NCPU; l++){
+    for(r = l->r; r != l->w; r++)
+      consputc(l->buf[r % CPULOGSIZE]);
+    l->r = r;
+  }
 }
 
 void
 panic(char *s)
 {
-  pr.locking = 0;
+  if(!panicking){
+    panicking = 1;
+    klogflush();
+  }
   printf("panic: ");
   printf(s);
   printf("\n");
@@ -129,6 +270,5 @@ panic(char *s)
 void
 printfinit(void)
 {
-  initlock(&pr.lock, "pr");
-  pr.locking = 1;
+  initlock(&klog.lock, "klog");
 }
@@ -3,45 +3,80 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 #include "defs.h"
+#include "trace.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// Process table.
+//
+// proc structs are allocated a page at a time, as they are
+// needed, up to NPROC of them, and recycled through a free
+// list. Each page counts its procs that are in use; once all
+// of them are UNUSED the page is unlinked and, after a grace
+// period, given back to kalloc().
+//
+// scheduler() and wakeup() walk allproc without tab_lock.
+// A CPU only does so within one pass of its scheduler loop,
+// or with interrupts off, so a page unlinked from allproc is
+// safe to free once every CPU has started a new pass. For the
+// same reason, code that holds a pointer to a proc that might
+// be freed must keep interrupts off until it has checked it.
+//
+// A pid hash finds the proc with a given pid, and each proc
+// keeps a list of its children, so that fork(), exit(), wait()
+// and kill() don't have to scan the whole table.
+
+#define NPIDHASH 256
+#define PIDHASH(pid) ((pid) & (NPIDHASH-1))
+
+// A page of proc structs.
+struct procpage {
+  struct procpage *next;   // on the retired list
+  int n;                   // number of procs on the page
+  int nused;               // how many of them are not UNUSED
+  uint64 seen[NCPU];       // each cpus[i].npass when retired
+  struct proc procs[];
+};
+
+#define PROCPAGE(p) ((struct procpage*)PGROUNDDOWN((uint64)(p)))
+
+// tab_lock protects the free list, the pid hash, nslot,
+// the retired list, nused and changes to allproc.
+struct spinlock tab_lock;
+struct proc *allproc;      // every proc struct, linked by allnext
+struct proc *freelist;     // UNUSED procs, linked by hashnext
+struct proc *pidhash[NPIDHASH];
+struct procpage *retired;  // unlinked pages waiting to be freed
+int nslot;                 // number of proc structs allocated
 
 struct proc *initproc;
 
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// helps ensure that wakeups of wait()ing parents are not lost,
+// and protects p->parent, p->children and p->sibling.
+// must be acquired before any p->lock.
+struct spinlock wait_lock;
+
 extern void forkret(void);
-static void wakeup1(struct proc *chan);
+static void kthreadret(void);
+static void wakeup1(struct proc *p);
 static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
+extern struct ushared *ushared; // trap.c
 
 // initialize the proc table at boot time.
 void
 procinit(void)
 {
-  struct proc *p;
-  
   initlock(&pid_lock, "nextpid");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-
-      // Allocate a page for the process's kernel stack.
-      // Map it high in memory, followed by an invalid
-      // guard page.
-      char *pa = kalloc();
-      if(pa == 0)
-        panic("kalloc");
-      uint64 va = KSTACK((int) (p - proc));
-      kvmmap(va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-      p->kstack = va;
-  }
-  kvminithart();
+  initlock(&tab_lock, "proctab");
+  initlock(&wait_lock, "wait_lock");
 }
 
 // Must be called with interrupts disabled,
@@ -85,7 +120,96 @@ allocpid() {
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
+// Allocate a page of proc structs, or as many as NPROC
+// still allows, and put them on the free list.
+// Caller must hold tab_lock.
+// Returns 0 if the table is full or memory is short.
+static int
+moreprocs(void)
+{
+  struct procpage *pg;
+  struct proc *p;
+  int i, n;
+
+  if(nslot >= NPROC || (pg = (struct procpage*)kalloc()) == 0)
+    return 0;
+  memset(pg, 0, PGSIZE);
+  n = (PGSIZE - sizeof(*pg)) / sizeof(struct proc);
+  if(n > NPROC - nslot)
+    n = NPROC - nslot;
+  pg->n = n;
+  for(i = 0; i < n; i++){
+    p = &pg->procs[i];
+    initlock(&p->lock, "proc");
+    p->state = UNUSED;
+    p->hashnext = freelist;
+    freelist = p;
+    // publish p only once it is initialized, since
+    // scheduler() and wakeup() walk allproc without tab_lock.
+    p->allnext = allproc;
+    __sync_synchronize();
+    allproc = p;
+  }
+  nslot += n;
+  return 1;
+}
+
+// Unlink the procs on pg, all of them UNUSED, from the free
+// list and from allproc, and leave pg for procreap() to free.
+// Caller must hold tab_lock.
+static void
+retire(struct procpage *pg)
+{
+  struct proc **pp;
+  int i;
+
+  for(pp = &freelist; *pp; ){
+    if(PROCPAGE(*pp) == pg)
+      *pp = (*pp)->hashnext;
+    else
+      pp = &(*pp)->hashnext;
+  }
+  // leave the unlinked procs' allnext alone, so that a
+  // scheduler() or wakeup() standing on one can go on.
+  for(pp = &allproc; *pp; ){
+    if(PROCPAGE(*pp) == pg)
+      *pp = (*pp)->allnext;
+    else
+      pp = &(*pp)->allnext;
+  }
+  nslot -= pg->n;
+  for(i = 0; i < NCPU; i++)
+    pg->seen[i] = cpus[i].npass;
+  pg->next = retired;
+  retired = pg;
+}
+
+// Free the retired pages that every CPU has started
+// a new scheduler pass since, and so can't be looking at.
+// A CPU that has never started one (npass 0) never walked.
+static void
+procreap(void)
+{
+  struct procpage *pg, **pgp;
+  int i;
+
+  acquire(&tab_lock);
+  for(pgp = &retired; (pg = *pgp) != 0; ){
+    for(i = 0; i < NCPU; i++){
+      if(pg->seen[i] != 0 && cpus[i].npass == pg->seen[i])
+        break;
+    }
+    if(i < NCPU){
+      pgp = &pg->next;
+      continue;
+    }
+    *pgp = pg->next;
+    kfree((void*)pg);
+  }
+  release(&tab_lock);
+}
+
+// Take an UNUSED proc off the free list.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
 // If there are no free procs, or a memory allocation fails, return 0.
@@ -94,25 +218,43 @@ allocproc(void)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
+  acquire(&tab_lock);
+  if(freelist == 0 && moreprocs() == 0){
+    release(&tab_lock);
+    return 0;
   }
-  return 0;
+  p = freelist;
+  freelist = p->hashnext;
+  p->hashnext = 0;
+  PROCPAGE(p)->nused++;
+  release(&tab_lock);
 
-found:
+  acquire(&p->lock);
   p->pid = allocpid();
+  memset(&p->ru, 0, sizeof(p->ru));
+  memset(&p->cru, 0, sizeof(p->cru));
+
+  acquire(&tab_lock);
+  p->hashnext = pidhash[PIDHASH(p->pid)];
+  pidhash[PIDHASH(p->pid)] = p;
+  release(&tab_lock);
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
+    freeproc(p);
     release(&p->lock);
     return 0;
   }
 
+  // The page through which user space reads its pid.
+  if((p->usyscall = (struct usyscall *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  pagezero(p->usyscall);
+  p->usyscall->pid = p->pid;
+
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
@@ -121,6 +263,15 @@ found:
     return 0;
   }
 
+  // The kernel page table to use while running p,
+  // which also maps p's kernel stack.
+  if((p->kpagetable = kvmcreate()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  p->kstack = KSTACK;
+
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
@@ -131,21 +282,52 @@ found:
 }
 
 // free a proc structure and the data hanging from it,
-// including user pages.
-// p->lock must be held.
+// including user pages and the kernel stack, and put
+// it back on the free list. If that leaves its page
+// unused, and it isn't the only page, retire the page.
+// p->lock must be held, and p must not be running.
 static void
 freeproc(struct proc *p)
 {
+  struct proc **pp;
+  struct procpage *pg;
+
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  if(p->kpagetable)
+    kvmfree(p->kpagetable);
+  p->kpagetable = 0;
+  p->kstack = 0;
+
+  acquire(&tab_lock);
+  for(pp = &pidhash[PIDHASH(p->pid)]; *pp; pp = &(*pp)->hashnext){
+    if(*pp == p){
+      *pp = p->hashnext;
+      break;
+    }
+  }
+  p->hashnext = freelist;
+  freelist = p;
+  pg = PROCPAGE(p);
+  if(--pg->nused == 0 && nslot > pg->n)
+    retire(pg);
+  release(&tab_lock);
+
   p->sz = 0;
+  p->ustack = 0;
   p->pid = 0;
   p->parent = 0;
+  p->children = 0;
+  p->sibling = 0;
   p->name[0] = 0;
+  p->kfn = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
@@ -182,6 +364,24 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the pages user space reads instead of
+  // calling getpid() and uptime(), read-only.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+  if(mappages(pagetable, USHARED, PGSIZE,
+              (uint64)ushared, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, USYSCALL, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -192,6 +392,8 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
+  uvmunmap(pagetable, USHARED, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -220,6 +422,7 @@ userinit(void)
   // and data into it.
   uvminit(p->pagetable, initcode, sizeof(initcode));
   p->sz = PGSIZE;
+  kvmsync(p->kpagetable, p->pagetable);
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
@@ -233,6 +436,23 @@ userinit(void)
   release(&p->lock);
 }
 
+// Start a kernel thread, which runs fn in the kernel and
+// never returns to user space. It has a proc of its own so
+// that it can sleep. fn must not return.
+void
+kthread(void (*fn)(void), char *name)
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    panic("kthread");
+  p->kfn = fn;
+  p->context.ra = (uint64)kthreadret;
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->state = RUNNABLE;
+  release(&p->lock);
+}
+
 // Grow or shrink user memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -243,13 +463,20 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
+    if((uint64)sz + n > MAXUVA)
+      return -1;
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
       return -1;
     }
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
+    // the stack guard page may be gone; if it comes
+    // back it will be an ordinary user page.
+    if(PGROUNDUP(sz) < p->ustack)
+      p->ustack = 0;
   }
   p->sz = sz;
+  kvmsync(p->kpagetable, p->pagetable);
   return 0;
 }
 
@@ -274,8 +501,8 @@ fork(void)
     return -1;
   }
   np->sz = p->sz;
-
-  np->parent = p;
+  np->ustack = p->ustack;
+  kvmsync(np->kpagetable, np->pagetable);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -293,37 +520,40 @@ fork(void)
 
   pid = np->pid;
 
-  np->state = RUNNABLE;
+  release(&np->lock);
 
+  acquire(&wait_lock);
+  np->parent = p;
+  np->sibling = p->children;
+  p->children = np;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
   release(&np->lock);
 
   return pid;
 }
 
 // Pass p's abandoned children to init.
-// Caller must hold p->lock.
+// Caller must hold wait_lock.
 void
 reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    // this code uses pp->parent without holding pp->lock.
-    // acquiring the lock first could cause a deadlock
-    // if pp or a child of pp were also in exit()
-    // and about to try to lock p.
-    if(pp->parent == p){
-      // pp->parent can't change between the check and the acquire()
-      // because only the parent changes it, and we're the parent.
-      acquire(&pp->lock);
-      pp->parent = initproc;
-      // we should wake up init here, but that would require
-      // initproc->lock, which would be a deadlock, since we hold
-      // the lock on one of init's children (pp). this is why
-      // exit() always wakes init (before acquiring any locks).
-      release(&pp->lock);
-    }
+  if(p->children == 0)
+    return;
+  for(pp = p->children; ; pp = pp->sibling){
+    pp->parent = initproc;
+    if(pp->sibling == 0)
+      break;
   }
+  pp->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+  // some of them may already be zombies.
+  wakeup1(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -351,98 +581,84 @@ exit(int status)
   end_op();
   p->cwd = 0;
 
-  // we might re-parent a child to init. we can't be precise about
-  // waking up init, since we can't acquire its lock once we've
-  // acquired any other proc lock. so wake up init whether that's
-  // necessary or not. init may miss this wakeup, but that seems
-  // harmless.
-  acquire(&initproc->lock);
-  wakeup1(initproc);
-  release(&initproc->lock);
-
-  // grab a copy of p->parent, to ensure that we unlock the same
-  // parent we locked. in case our parent gives us away to init while
-  // we're waiting for the parent lock. we may then race with an
-  // exiting parent, but the result will be a harmless spurious wakeup
-  // to a dead or wrong process; proc structs are never re-allocated
-  // as anything else.
-  acquire(&p->lock);
-  struct proc *original_parent = p->parent;
-  release(&p->lock);
-  
-  // we need the parent's lock in order to wake it up from wait().
-  // the parent-then-child rule says we have to lock it first.
-  acquire(&original_parent->lock);
-
-  acquire(&p->lock);
+  acquire(&wait_lock);
 
   // Give any children to init.
   reparent(p);
 
   // Parent might be sleeping in wait().
-  wakeup1(original_parent);
+  wakeup1(p->parent);
+
+  acquire(&p->lock);
 
   p->xstate = status;
   p->state = ZOMBIE;
 
-  release(&original_parent->lock);
+  release(&wait_lock);
 
   // Jump into the scheduler, never to return.
   sched();
   panic("zombie exit");
 }
 
+// Add the counters in src to those in dst.
+static void
+ruadd(struct rusage *dst, struct rusage *src)
+{
+  uint64 *d = (uint64*)dst, *s = (uint64*)src;
+  int i;
+
+  for(i = 0; i < sizeof(struct rusage)/sizeof(uint64); i++)
+    d[i] += s[i];
+}
+
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
+// Adds the child's resource usage to this process's cru.
 int
 wait(uint64 addr)
 {
-  struct proc *np;
-  int havekids, pid;
+  struct proc *np, **npp;
+  int pid;
   struct proc *p = myproc();
 
-  // hold p->lock for the whole time to avoid lost
+  // hold wait_lock for the whole time to avoid lost
   // wakeups from a child's exit().
-  acquire(&p->lock);
+  acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      // this code uses np->parent without holding np->lock.
-      // acquiring the lock first would cause a deadlock,
-      // since np might be an ancestor, and we already hold p->lock.
-      if(np->parent == p){
-        // np->parent can't change between the check and the acquire()
-        // because only the parent changes it, and we're the parent.
-        acquire(&np->lock);
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&p->lock);
-            return -1;
-          }
-          freeproc(np);
+    // Scan through our children looking for exited ones.
+    for(npp = &p->children; (np = *npp) != 0; npp = &np->sibling){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      if(np->state == ZOMBIE){
+        // Found one.
+        pid = np->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                sizeof(np->xstate)) < 0) {
           release(&np->lock);
-          release(&p->lock);
-          return pid;
+          release(&wait_lock);
+          return -1;
         }
+        *npp = np->sibling;
+        ruadd(&p->cru, &np->ru);
+        ruadd(&p->cru, &np->cru);
+        freeproc(np);
         release(&np->lock);
+        release(&wait_lock);
+        return pid;
       }
+      release(&np->lock);
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
-      release(&p->lock);
+    if(p->children == 0 || p->killed){
+      release(&wait_lock);
       return -1;
     }
     
     // Wait for a child to exit.
-    sleep(p, &p->lock);  //DOC: wait-sleep
+    sleep(p, &wait_lock);  //DOC: wait-sleep
   }
 }
 
@@ -461,11 +677,18 @@ scheduler(void)
   
   c->proc = 0;
   for(;;){
+    // a new pass holds no pointers into allproc from the
+    // last one; let procreap() know.
+    __sync_synchronize();
+    c->npass++;
+    if(retired)
+      procreap();
+
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
     
     int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
+    for(p = allproc; p; p = p->allnext) {
       acquire(&p->lock);
       if(p->state == RUNNABLE) {
         // Switch to chosen process.  It is the process's job
@@ -473,12 +696,24 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
+
+        // run on p's kernel page table, which also maps
+        // p's user memory for copyin() and copyout().
+        w_satp(MAKE_SATP(p->kpagetable));
+        sfence_vma();
+
+        TRACE(TR_SWITCHIN, p->pid, 0);
         swtch(&c->context, &p->context);
 
         // Process is done running for now.
         // It should have changed its p->state before coming back.
+        TRACE(TR_SWITCHOUT, p->pid, p->state);
         c->proc = 0;
 
+        // p's kernel page table may be freed once
+        // we release p->lock.
+        kvminithart();
+
         found = 1;
       }
       release(&p->lock);
@@ -524,6 +759,7 @@ yield(void)
   struct proc *p = myproc();
   acquire(&p->lock);
   p->state = RUNNABLE;
+  p->ru.nivcsw++;
   sched();
   release(&p->lock);
 }
@@ -549,6 +785,17 @@ forkret(void)
   usertrapret();
 }
 
+// A kernel thread's very first scheduling by scheduler()
+// will swtch to kthreadret.
+static void
+kthreadret(void)
+{
+  // Still holding p->lock from scheduler.
+  release(&myproc()->lock);
+  myproc()->kfn();
+  panic("kthreadret");
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
@@ -568,8 +815,10 @@ sleep(void *chan, struct spinlock *lk)
   }
 
   // Go to sleep.
+  TRACE(TR_SLEEP, (uint64)chan, 0);
   p->chan = chan;
   p->state = SLEEPING;
+  p->ru.nvcsw++;
 
   sched();
 
@@ -590,25 +839,33 @@ wakeup(void *chan)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  // keep interrupts off, so that this CPU can't yield
+  // mid-walk and let procreap() free a page under us.
+  push_off();
+  for(p = allproc; p; p = p->allnext) {
     acquire(&p->lock);
     if(p->state == SLEEPING && p->chan == chan) {
+      TRACE(TR_WAKEUP, (uint64)chan, p->pid);
       p->state = RUNNABLE;
     }
     release(&p->lock);
   }
+  pop_off();
 }
 
 // Wake up p if it is sleeping in wait(); used by exit().
-// Caller must hold p->lock.
+// Caller must hold wait_lock, and no p->lock.
 static void
 wakeup1(struct proc *p)
 {
-  if(!holding(&p->lock))
+  if(!holding(&wait_lock))
     panic("wakeup1");
+  acquire(&p->lock);
   if(p->chan == p && p->state == SLEEPING) {
+    TRACE(TR_WAKEUP, (uint64)p, p->pid);
     p->state = RUNNABLE;
   }
+  release(&p->lock);
 }
 
 // Kill the process with the given pid.
@@ -619,20 +876,51 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
+  // with interrupts off p's page can't be freed, but p
+  // may have been recycled once we drop tab_lock.
+  push_off();
+  acquire(&tab_lock);
+  for(p = pidhash[PIDHASH(pid)]; p; p = p->hashnext){
+    if(p->pid == pid)
+      break;
+  }
+  release(&tab_lock);
+  if(p == 0){
+    pop_off();
+    return -1;
+  }
+
+  acquire(&p->lock);
+  if(p->pid != pid){
     release(&p->lock);
+    pop_off();
+    return -1;
   }
-  return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    p->state = RUNNABLE;
+  }
+  release(&p->lock);
+  pop_off();
+  return 0;
+}
+
+// Copy the resource usage of this process, or of its
+// waited-for children, to the user address addr.
+int
+getrusage(int who, uint64 addr)
+{
+  struct proc *p = myproc();
+  struct rusage *ru;
+
+  if(who == RUSAGE_SELF)
+    ru = &p->ru;
+  else if(who == RUSAGE_CHILDREN)
+    ru = &p->cru;
+  else
+    return -1;
+  return copyout(p->pagetable, addr, (char*)ru, sizeof(*ru));
 }
 
 // Copy to either a user address, or kernel address,
@@ -682,7 +970,7 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(p = allproc; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
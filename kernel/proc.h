@@ -24,6 +24,7 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 npass;               // Passes scheduler() has started over allproc.
 };
 
 extern struct cpu cpus[NCPU];
@@ -88,19 +89,35 @@ struct proc {
 
   // p->lock must be held when using these:
   enum procstate state;        // Process state
-  struct proc *parent;         // Parent process
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
+  // wait_lock must be held when using these:
+  struct proc *parent;         // Parent process
+  struct proc *children;       // First child
+  struct proc *sibling;        // Next child of parent
+
+  // tab_lock must be held when using this:
+  struct proc *hashnext;       // Next in pid hash chain, or on free list
+
+  // tab_lock must be held to change this:
+  struct proc *allnext;        // Next in list of all proc structs
+
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
+  uint64 ustack;               // Bottom of user stack, above its guard page, or 0
   pagetable_t pagetable;       // User page table
+  pagetable_t kpagetable;      // Kernel page table, also mapping user memory
   struct trapframe *trapframe; // data page for trampoline.S
+  struct usyscall *usyscall;   // page user space reads at USYSCALL
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  void (*kfn)(void);           // What a kernel thread runs, or 0
+  struct rusage ru;            // Resources used so far
+  struct rusage cru;           // Resources used by waited-for children
 };
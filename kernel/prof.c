@@ -0,0 +1,132 @@
+// Sampling profiler.
+//
+// While profiling is on, each CPU's timer interrupt records
+// the interrupted pc in that CPU's ring of samples, and
+// prof() drains the rings into user space. Only the CPU
+// itself adds to its ring, with interrupts off, and only
+// prof() removes from it, holding proflock, so tail and head
+// each have a single writer and the interrupt takes no lock.
+// A full ring drops samples rather than overwrite them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "rusage.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+#define NPROFSAMPLE 1024  // samples buffered per CPU
+
+struct profring {
+  struct sample buf[NPROFSAMPLE];
+  uint head;    // next sample to drain; written by prof()
+  uint tail;    // next free slot; written by the CPU
+  uint ndrop;   // samples lost to a full ring
+} __attribute__((aligned(64)));
+
+static struct profring rings[NCPU];
+static struct spinlock proflock;
+
+// checked by devintr() on every timer interrupt.
+volatile int profiling;
+
+void
+profinit(void)
+{
+  initlock(&proflock, "prof");
+}
+
+// Record the pc interrupted by a timer interrupt.
+// Called by devintr() with interrupts off.
+void
+profsample(void)
+{
+  struct profring *r;
+  struct sample *s;
+  struct proc *p;
+
+  r = &rings[cpuid()];
+  if(r->tail - *(volatile uint*)&r->head == NPROFSAMPLE){
+    r->ndrop++;
+    return;
+  }
+  s = &r->buf[r->tail % NPROFSAMPLE];
+  s->pc = r_sepc();
+  s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+  p = myproc();
+  s->pid = p ? p->pid : 0;
+  // the sample must be complete before prof() can see it.
+  __sync_synchronize();
+  r->tail++;
+}
+
+// Copy up to n buffered samples to the user array at addr,
+// oldest first on each CPU. Returns the number copied, or -1.
+static int
+profread(uint64 addr, int n)
+{
+  struct profring *r;
+  uint head, tail, m;
+  int tot;
+
+  tot = 0;
+  for(r = rings; r < rings + NCPU && tot < n; r++){
+    head = r->head;
+    tail = *(volatile uint*)&r->tail;
+    __sync_synchronize();
+    while(head != tail && tot < n){
+      // the samples up to the end of buf, or to tail.
+      m = NPROFSAMPLE - head % NPROFSAMPLE;
+      if(m > tail - head)
+        m = tail - head;
+      if(m > n - tot)
+        m = n - tot;
+      if(copyout(myproc()->pagetable, addr + tot*sizeof(struct sample),
+                 (char*)&r->buf[head % NPROFSAMPLE], m*sizeof(struct sample)) < 0)
+        return -1;
+      head += m;
+      tot += m;
+    }
+    // done reading the slots before the CPU may reuse them.
+    __sync_synchronize();
+    r->head = head;
+  }
+  return tot;
+}
+
+int
+prof(int cmd, uint64 addr, int n)
+{
+  struct profring *r;
+  int ret;
+
+  acquire(&proflock);
+  switch(cmd){
+  case PROF_START:
+    profiling = 0;
+    for(r = rings; r < rings + NCPU; r++){
+      r->head = *(volatile uint*)&r->tail;
+      r->ndrop = 0;
+    }
+    __sync_synchronize();
+    profiling = 1;
+    ret = 0;
+    break;
+  case PROF_STOP:
+    profiling = 0;
+    ret = 0;
+    for(r = rings; r < rings + NCPU; r++)
+      ret += r->ndrop;
+    break;
+  case PROF_READ:
+    ret = n < 0 ? -1 : profread(addr, n);
+    break;
+  default:
+    ret = -1;
+  }
+  release(&proflock);
+  return ret;
+}
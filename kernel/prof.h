@@ -0,0 +1,12 @@
+// Sampling profiler commands and samples, for prof().
+// Both the kernel and user programs use this header file.
+
+#define PROF_START 1  // discard old samples and start sampling
+#define PROF_STOP  2  // stop sampling; returns samples dropped
+#define PROF_READ  3  // copy out and remove buffered samples
+
+struct sample {
+  uint64 pc;    // interrupted pc
+  int pid;      // running process, or 0 if none
+  int user;     // 1 if pc is a user address
+};
@@ -0,0 +1,42 @@
+// Submission and completion queues for ringenter(), which
+// runs a batch of file system calls in one trip into the
+// kernel. Both the kernel and user programs use this header file.
+//
+// The ring lives in user memory. User code fills sq[] entries
+// and advances sqtail; ringenter() consumes them, advancing
+// sqhead, and posts a result for each one at cq[cqtail],
+// which user code consumes by advancing cqhead. Indices count
+// up forever; entry i is at [i % RING_SIZE].
+
+#define RING_SIZE 64   // entries in each queue
+
+// operations
+#define RING_NOP    0
+#define RING_READ   1  // read(fd, addr, len), or pread() if off >= 0
+#define RING_WRITE  2  // write(fd, addr, len), or pwrite() if off >= 0
+#define RING_OPEN   3  // open(addr, len)
+#define RING_CLOSE  4  // close(fd)
+#define RING_FSTAT  5  // fstat(fd, addr)
+
+struct sqe {
+  int op;          // RING_*
+  int fd;
+  uint64 addr;     // buffer, path or struct stat
+  int len;         // byte count, or open() flags
+  int off;         // file offset, or -1 for the file's own
+  uint64 data;     // passed through to the completion
+};
+
+struct cqe {
+  uint64 data;     // from the submission
+  int res;         // what the system call would have returned
+};
+
+struct ring {
+  uint sqhead;     // advanced by the kernel
+  uint sqtail;     // advanced by user code
+  uint cqhead;     // advanced by user code
+  uint cqtail;     // advanced by the kernel
+  struct sqe sq[RING_SIZE];
+  struct cqe cq[RING_SIZE];
+};
@@ -0,0 +1,17 @@
+// Resource usage counters, as returned by getrusage().
+// Both the kernel and user programs use this header file.
+
+#define RUSAGE_SELF      0   // the calling process
+#define RUSAGE_CHILDREN  (-1) // its children that it has waited for
+
+struct rusage {
+  uint64 utime;     // timer ticks in user space
+  uint64 stime;     // timer ticks in the kernel
+  uint64 nvcsw;     // voluntary context switches (sleep)
+  uint64 nivcsw;    // involuntary context switches (yield)
+  uint64 nfault;    // page faults
+  uint64 inblock;   // blocks read from disk by bread()
+  uint64 oublock;   // blocks written through log_write()
+  uint64 piped;     // bytes written to pipes
+  uint64 nsyscall;  // system calls
+};
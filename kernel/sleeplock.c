@@ -6,27 +6,88 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 #include "sleeplock.h"
 
+// How many times acquiresleep() polls a holder that is
+// running on another CPU before going to sleep.
+#define SLEEPSPIN 1000
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->nshared = 0;
+  lk->nwaiting = 0;
   lk->pid = 0;
+  lk->proc = 0;
+  lk->stat = lockstatfor(name, 1);
+  lk->t0 = 0;
 }
 
+// Count an acquisition of lk that polled spins times
+// and slept sleeps times. Caller holds lk->lk.
+static void
+sleepstat(struct sleeplock *lk, int spins, int sleeps)
+{
+  int id = cpuid();
+
+  if(lk->stat == 0)
+    return;
+  lk->stat->cpu[id].nacquire++;
+  if(spins || sleeps){
+    lk->stat->cpu[id].ncontend++;
+    lk->stat->cpu[id].nspin += spins;
+    lk->stat->cpu[id].nsleep += sleeps;
+  }
+}
+
+// Is the exclusive holder of lk still holder, and running?
+// Reads without locks, so the worst outcome is a wrong guess;
+// callers keep interrupts off so that holder's page isn't
+// freed meanwhile (see proc.c).
+static int
+holderrunning(struct sleeplock *lk, struct proc *holder)
+{
+  return *(struct proc * volatile *)&lk->proc == holder &&
+    *(volatile enum procstate *)&holder->state == RUNNING;
+}
+
+// Acquire lk exclusively. If another process holds it and
+// is running on another CPU, it is likely to let go soon,
+// so poll for a while rather than sleep straight away.
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct proc *holder;
+  int spins = 0, sleeps = 0;
+
   acquire(&lk->lk);
-  while (lk->locked) {
+  while (lk->locked || lk->nshared > 0) {
+    holder = lk->proc;
+    if(lk->locked && spins < SLEEPSPIN && holderrunning(lk, holder)){
+      push_off();
+      release(&lk->lk);
+      while(spins < SLEEPSPIN && holderrunning(lk, holder))
+        spins++;
+      acquire(&lk->lk);
+      pop_off();
+      continue;
+    }
+    // keep new readers out, so they can't starve us.
+    lk->nwaiting++;
     sleep(lk, &lk->lk);
+    lk->nwaiting--;
+    sleeps++;
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->proc = myproc();
+  sleepstat(lk, spins, sleeps);
+  lk->t0 = r_time();
   release(&lk->lk);
 }
 
@@ -34,12 +95,46 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  // holds often sleep and end on another CPU, so time
+  // them with the shared time counter, not r_cycle().
+  if(lk->stat)
+    lk->stat->cpu[cpuid()].holdcycles += r_time() - lk->t0;
   lk->locked = 0;
   lk->pid = 0;
+  lk->proc = 0;
   wakeup(lk);
   release(&lk->lk);
 }
 
+// Acquire lk shared with other readers. Waits while a
+// process holds it exclusively or waits to.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  int sleeps = 0;
+
+  acquire(&lk->lk);
+  while (lk->locked || lk->nwaiting > 0) {
+    sleep(lk, &lk->lk);
+    sleeps++;
+  }
+  lk->nshared++;
+  sleepstat(lk, 0, sleeps);
+  release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->nshared < 1)
+    panic("releasesleepshared");
+  lk->nshared--;
+  if(lk->nshared == 0)
+    wakeup(lk);
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
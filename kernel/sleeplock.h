@@ -1,10 +1,19 @@
 // Long-term locks for processes
+// Held either by one process (exclusive), or by any
+// number of readers (shared).
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  int nshared;       // Number of shared holders
+  int nwaiting;      // Exclusive acquirers asleep on the lock
   struct spinlock lk; // spinlock protecting this sleep lock
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct proc *proc; // Process holding lock, for acquiresleep()
+
+  // For profiling (lockstat.c):
+  struct lockstat *stat; // Counters for locks of this name, or 0
+  uint64 t0;         // r_time() when acquired exclusively
 };
 
@@ -1,9 +1,28 @@
 // Mutual exclusion lock.
+// A ticket lock: CPUs get the lock in the order they ask.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;         // Next ticket to hand out
+  uint owner;        // Ticket now allowed to hold the lock
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // For profiling (lockstat.c):
+  struct lockstat *stat; // Counters for locks of this name, or 0
+  uint64 t0;         // Cycle counter when acquired
 };
 
+// Contention counters shared by all locks with the same
+// name, kept per CPU so that updating them needs no atomics.
+struct lockstat {
+  char *name;
+  int sleep;         // Counts sleep locks, not spinlocks?
+  struct {
+    uint64 nacquire;   // acquisitions
+    uint64 ncontend;   // acquisitions that had to wait
+    uint64 nspin;      // polls while waiting
+    uint64 nsleep;     // sleeps while waiting (sleep locks)
+    uint64 holdcycles; // cycles held exclusively
+  } __attribute__((aligned(64))) cpu[NCPU];
+};
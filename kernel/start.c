@@ -38,6 +38,11 @@ start()
   w_mideleg(0xffff);
   w_sie(r_sie() | SIE_SEIE | SIE_STIE | SIE_SSIE);
 
+  // let supervisor and user mode read the cycle, time
+  // and instret counters, e.g. for user/trapbench.c.
+  w_mcounteren(r_mcounteren() | 0x7);
+  w_scounteren(r_scounteren() | 0x7);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -1,13 +1,39 @@
 #include "types.h"
+#include "riscv.h"
+
+// memset, memcmp and memmove work a 64-bit word at a time,
+// four words per loop iteration, whenever the pointers
+// involved have the same alignment; only the unaligned head
+// and the tail are handled a byte at a time.
+
+#define WORDMASK (sizeof(uint64) - 1)
 
 void*
 memset(void *dst, int c, uint n)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uchar *d = dst;
+  uint64 w, *wd;
+
+  while(n > 0 && ((uint64)d & WORDMASK)){
+    *d++ = c;
+    n--;
+  }
+  w = (uchar)c;
+  w |= w << 8;
+  w |= w << 16;
+  w |= w << 32;
+  wd = (uint64*)d;
+  for(; n >= 4*sizeof(uint64); n -= 4*sizeof(uint64), wd += 4){
+    wd[0] = w;
+    wd[1] = w;
+    wd[2] = w;
+    wd[3] = w;
   }
+  for(; n >= sizeof(uint64); n -= sizeof(uint64))
+    *wd++ = w;
+  d = (uchar*)wd;
+  while(n-- > 0)
+    *d++ = c;
   return dst;
 }
 
@@ -15,9 +41,27 @@ int
 memcmp(const void *v1, const void *v2, uint n)
 {
   const uchar *s1, *s2;
+  const uint64 *w1, *w2;
 
   s1 = v1;
   s2 = v2;
+  if((((uint64)s1 ^ (uint64)s2) & WORDMASK) == 0){
+    while(n > 0 && ((uint64)s1 & WORDMASK)){
+      if(*s1 != *s2)
+        return *s1 - *s2;
+      s1++, s2++, n--;
+    }
+    // skip equal words; a differing word is
+    // left for the byte loop to pin down.
+    w1 = (const uint64*)s1;
+    w2 = (const uint64*)s2;
+    while(n >= sizeof(uint64) && *w1 == *w2){
+      w1++, w2++;
+      n -= sizeof(uint64);
+    }
+    s1 = (const uchar*)w1;
+    s2 = (const uchar*)w2;
+  }
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -32,21 +76,101 @@ memmove(void *dst, const void *src, uint n)
 {
   const char *s;
   char *d;
+  const uint64 *ws;
+  uint64 *wd;
+  int aligned;
 
   s = src;
   d = dst;
+  aligned = (((uint64)s ^ (uint64)d) & WORDMASK) == 0;
   if(s < d && s + n > d){
     s += n;
     d += n;
+    if(aligned){
+      while(n > 0 && ((uint64)d & WORDMASK)){
+        *--d = *--s;
+        n--;
+      }
+      ws = (const uint64*)s;
+      wd = (uint64*)d;
+      for(; n >= 4*sizeof(uint64); n -= 4*sizeof(uint64)){
+        ws -= 4, wd -= 4;
+        wd[3] = ws[3];
+        wd[2] = ws[2];
+        wd[1] = ws[1];
+        wd[0] = ws[0];
+      }
+      for(; n >= sizeof(uint64); n -= sizeof(uint64))
+        *--wd = *--ws;
+      s = (const char*)ws;
+      d = (char*)wd;
+    }
     while(n-- > 0)
       *--d = *--s;
-  } else
+  } else {
+    if(aligned){
+      while(n > 0 && ((uint64)d & WORDMASK)){
+        *d++ = *s++;
+        n--;
+      }
+      ws = (const uint64*)s;
+      wd = (uint64*)d;
+      for(; n >= 4*sizeof(uint64); n -= 4*sizeof(uint64), ws += 4, wd += 4){
+        wd[0] = ws[0];
+        wd[1] = ws[1];
+        wd[2] = ws[2];
+        wd[3] = ws[3];
+      }
+      for(; n >= sizeof(uint64); n -= sizeof(uint64))
+        *wd++ = *ws++;
+      s = (const char*)ws;
+      d = (char*)wd;
+    }
     while(n-- > 0)
       *d++ = *s++;
+  }
 
   return dst;
 }
 
+// Zero a page-aligned 4096-byte page.
+void
+pagezero(void *pa)
+{
+  uint64 *p = pa, *e = p + PGSIZE/sizeof(uint64);
+
+  for(; p < e; p += 8){
+    p[0] = 0;
+    p[1] = 0;
+    p[2] = 0;
+    p[3] = 0;
+    p[4] = 0;
+    p[5] = 0;
+    p[6] = 0;
+    p[7] = 0;
+  }
+}
+
+// Copy one page-aligned 4096-byte page to another.
+// The pages must not overlap.
+void
+pagecopy(void *dst, const void *src)
+{
+  uint64 *d = dst, *e = d + PGSIZE/sizeof(uint64);
+  const uint64 *s = src;
+
+  for(; d < e; d += 8, s += 8){
+    d[0] = s[0];
+    d[1] = s[1];
+    d[2] = s[2];
+    d[3] = s[3];
+    d[4] = s[4];
+    d[5] = s[5];
+    d[6] = s[6];
+    d[7] = s[7];
+  }
+}
+
 // memcpy exists to placate GCC.  Use memmove.
 void*
 memcpy(void *dst, const void *src, uint n)
@@ -3,9 +3,11 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
+#include "trace.h"
 
 // Fetch the uint64 at addr from the current process.
 int
@@ -104,6 +106,21 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_ringenter(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_ktrace(void);
+extern uint64 sys_getrusage(void);
+extern uint64 sys_dmesg(void);
+extern uint64 sys_ioctl(void);
+extern uint64 sys_diskstat(void);
+extern uint64 sys_fsync(void);
+extern uint64 sys_sync(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -127,6 +144,21 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_splice]  sys_splice,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_ringenter] sys_ringenter,
+[SYS_lockstat] sys_lockstat,
+[SYS_prof]    sys_prof,
+[SYS_ktrace]  sys_ktrace,
+[SYS_getrusage] sys_getrusage,
+[SYS_dmesg]   sys_dmesg,
+[SYS_ioctl]   sys_ioctl,
+[SYS_diskstat] sys_diskstat,
+[SYS_fsync]   sys_fsync,
+[SYS_sync]    sys_sync,
 };
 
 void
@@ -137,7 +169,10 @@ syscall(void)
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    p->ru.nsyscall++;
+    TRACE(TR_SYSENTER, num, 0);
     p->trapframe->a0 = syscalls[num]();
+    TRACE(TR_SYSEXIT, num, p->trapframe->a0);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
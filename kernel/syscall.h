@@ -20,3 +20,18 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_splice 22
+#define SYS_readv  23
+#define SYS_writev 24
+#define SYS_pread  25
+#define SYS_pwrite 26
+#define SYS_ringenter 27
+#define SYS_lockstat 28
+#define SYS_prof   29
+#define SYS_ktrace 30
+#define SYS_getrusage 31
+#define SYS_dmesg  32
+#define SYS_ioctl  33
+#define SYS_diskstat 34
+#define SYS_fsync  35
+#define SYS_sync   36
@@ -10,11 +10,23 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "uio.h"
+#include "ring.h"
+
+// Return the open file for descriptor fd, or 0.
+static struct file*
+fdfile(int fd)
+{
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  return myproc()->ofile[fd];
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -26,7 +38,7 @@ argfd(int n, int *pfd, struct file **pf)
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((f = fdfile(fd)) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -91,6 +103,96 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// Move up to n bytes from fdin to fdout without copying
+// them through user space.
+uint64
+sys_splice(void)
+{
+  struct file *fin, *fout;
+  int n;
+
+  if(argfd(0, 0, &fin) < 0 || argfd(1, 0, &fout) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filesplice(fin, fout, n);
+}
+
+// Fetch the user's array of cnt iovecs at argument n into iov.
+// Rejects vectors whose total length does not fit in an int.
+static int
+argiov(int n, int cnt, struct iovec *iov)
+{
+  uint64 uiov, tot;
+  int i;
+
+  if(argaddr(n, &uiov) < 0)
+    return -1;
+  if(cnt < 0 || cnt > MAXIOV)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, uiov, cnt*sizeof(struct iovec)) < 0)
+    return -1;
+  tot = 0;
+  for(i = 0; i < cnt; i++){
+    if(iov[i].iov_len > 0x7fffffff)
+      return -1;
+    tot += iov[i].iov_len;
+    if(tot > 0x7fffffff)
+      return -1;
+  }
+  return 0;
+}
+
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[MAXIOV];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, iov) < 0)
+    return -1;
+  return filereadv(f, iov, cnt);
+}
+
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[MAXIOV];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, iov) < 0)
+    return -1;
+  return filewritev(f, iov, cnt);
+}
+
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(n < 0 || off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(n < 0 || off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
 uint64
 sys_close(void)
 {
@@ -115,6 +217,40 @@ sys_fstat(void)
   return filestat(f, st);
 }
 
+// Make fd's file durable. All changes to files share one
+// transaction, so this commits everyone's.
+uint64
+sys_fsync(void)
+{
+  struct file *f;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  if(f->type != FD_INODE && f->type != FD_DEVICE)
+    return -1;
+  log_sync();
+  return 0;
+}
+
+uint64
+sys_sync(void)
+{
+  log_sync();
+  return 0;
+}
+
+uint64
+sys_ioctl(void)
+{
+  struct file *f;
+  int req;
+  uint64 arg;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &req) < 0 || argaddr(2, &arg) < 0)
+    return -1;
+  return fileioctl(f, req, arg);
+}
+
 // Create the path new as a link to the same inode as old.
 uint64
 sys_link(void)
@@ -283,17 +419,13 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-uint64
-sys_open(void)
+// Open path with mode omode and return a new descriptor.
+static int
+fileopen(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
-    return -1;
 
   begin_op();
 
@@ -351,6 +483,100 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return fileopen(path, omode);
+}
+
+// Run one ring operation, as the system call would.
+static int
+ringop(struct sqe *e)
+{
+  struct proc *p = myproc();
+  struct file *f;
+  char path[MAXPATH];
+
+  if(e->op == RING_NOP)
+    return 0;
+  if(e->op == RING_OPEN){
+    if(copyinstr(p->pagetable, path, e->addr, MAXPATH) < 0)
+      return -1;
+    return fileopen(path, e->len);
+  }
+
+  if((f = fdfile(e->fd)) == 0)
+    return -1;
+  switch(e->op){
+  case RING_READ:
+  case RING_WRITE:
+    if(e->len < 0)
+      return -1;
+    if(e->off < 0){
+      if(e->op == RING_READ)
+        return fileread(f, e->addr, e->len);
+      return filewrite(f, e->addr, e->len);
+    }
+    if(e->op == RING_READ)
+      return filepread(f, e->addr, e->len, e->off);
+    return filepwrite(f, e->addr, e->len, e->off);
+  case RING_CLOSE:
+    p->ofile[e->fd] = 0;
+    fileclose(f);
+    return 0;
+  case RING_FSTAT:
+    return filestat(f, e->addr);
+  }
+  return -1;
+}
+
+// Run the operations queued on the user's struct ring,
+// posting each result on its completion queue, until the
+// submission queue is empty or the completion queue full.
+// Returns the number of operations run.
+uint64
+sys_ringenter(void)
+{
+  struct proc *p = myproc();
+  struct ring *r;
+  uint sqhead, sqtail, cqhead, cqtail;
+  struct sqe e;
+  struct cqe c;
+  uint64 ur;
+  int n;
+
+  if(argaddr(0, &ur) < 0)
+    return -1;
+  r = (struct ring*)ur;
+  if(copyin(p->pagetable, (char*)&sqhead, (uint64)&r->sqhead, sizeof(uint)) < 0 ||
+     copyin(p->pagetable, (char*)&sqtail, (uint64)&r->sqtail, sizeof(uint)) < 0 ||
+     copyin(p->pagetable, (char*)&cqhead, (uint64)&r->cqhead, sizeof(uint)) < 0 ||
+     copyin(p->pagetable, (char*)&cqtail, (uint64)&r->cqtail, sizeof(uint)) < 0)
+    return -1;
+  if(sqtail - sqhead > RING_SIZE || cqtail - cqhead > RING_SIZE)
+    return -1;
+
+  for(n = 0; sqhead != sqtail && cqtail - cqhead < RING_SIZE && !p->killed; n++){
+    if(copyin(p->pagetable, (char*)&e, (uint64)&r->sq[sqhead % RING_SIZE], sizeof(e)) < 0)
+      return -1;
+    c.data = e.data;
+    c.res = ringop(&e);
+    if(copyout(p->pagetable, (uint64)&r->cq[cqtail % RING_SIZE], (char*)&c, sizeof(c)) < 0)
+      return -1;
+    sqhead++;
+    cqtail++;
+    if(copyout(p->pagetable, (uint64)&r->sqhead, (char*)&sqhead, sizeof(uint)) < 0 ||
+       copyout(p->pagetable, (uint64)&r->cqtail, (char*)&cqtail, sizeof(uint)) < 0)
+      return -1;
+  }
+  return n;
+}
+
 uint64
 sys_mkdir(void)
 {
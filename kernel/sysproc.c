@@ -5,6 +5,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 
 uint64
@@ -38,6 +39,17 @@ sys_wait(void)
   return wait(p);
 }
 
+uint64
+sys_getrusage(void)
+{
+  int who;
+  uint64 addr;
+
+  if(argint(0, &who) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  return getrusage(who, addr);
+}
+
 uint64
 sys_sbrk(void)
 {
@@ -95,3 +107,62 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// Copy out lock contention counters; see lockstat.c.
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n, reset;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0 || argint(2, &reset) < 0)
+    return -1;
+  return lockstatcopy(addr, n, reset);
+}
+
+// Copy out recent kernel printf() output; see printf.c.
+uint64
+sys_dmesg(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return dmesg(addr, n);
+}
+
+// Copy out the disk driver's counters; see virtio_disk.c.
+uint64
+sys_diskstat(void)
+{
+  uint64 addr;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  return diskstat(addr);
+}
+
+// Start, stop, or drain the sampling profiler; see prof.c.
+uint64
+sys_prof(void)
+{
+  uint64 addr;
+  int cmd, n;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  return prof(cmd, addr, n);
+}
+
+// Start, stop, or drain the trace rings; see trace.c.
+uint64
+sys_ktrace(void)
+{
+  uint64 addr;
+  int cmd, n;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  return ktrace(cmd, addr, n);
+}
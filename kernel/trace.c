@@ -0,0 +1,138 @@
+// Kernel tracepoints.
+//
+// TRACE() in defs.h records an event in the current CPU's
+// ring of trace records, if tracing is on, and ktrace() drains
+// the rings into user space. As in prof.c, each ring has one
+// producer, its CPU with interrupts off, and one consumer,
+// ktrace() holding tracelock, so recording takes no lock.
+// A full ring drops records rather than overwrite them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "rusage.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+
+#define NTRACEREC 2048  // records buffered per CPU
+
+struct tracering {
+  struct trec buf[NTRACEREC];
+  uint head;    // next record to drain; written by ktrace()
+  uint tail;    // next free slot; written by the CPU
+  uint ndrop;   // records lost to a full ring
+} __attribute__((aligned(64)));
+
+static struct tracering rings[NCPU];
+static struct spinlock tracelock;
+
+// checked by TRACE() at every tracepoint.
+volatile int tracing;
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Record an event; called through TRACE().
+void
+tracerecord(int type, uint64 a0, uint64 a1)
+{
+  struct tracering *r;
+  struct trec *t;
+  struct cpu *c;
+  int id;
+
+  push_off();
+  id = cpuid();
+  r = &rings[id];
+  if(r->tail - *(volatile uint*)&r->head == NTRACEREC){
+    r->ndrop++;
+    pop_off();
+    return;
+  }
+  c = mycpu();
+  t = &r->buf[r->tail % NTRACEREC];
+  t->time = r_time();
+  t->type = type;
+  t->cpu = id;
+  t->pid = c->proc ? c->proc->pid : 0;
+  t->a0 = a0;
+  t->a1 = a1;
+  // the record must be complete before ktrace() can see it.
+  __sync_synchronize();
+  r->tail++;
+  pop_off();
+}
+
+// Copy up to n buffered records to the user array at addr,
+// each CPU's in time order. Returns the number copied, or -1.
+static int
+traceread(uint64 addr, int n)
+{
+  struct tracering *r;
+  uint head, tail, m;
+  int tot;
+
+  tot = 0;
+  for(r = rings; r < rings + NCPU && tot < n; r++){
+    head = r->head;
+    tail = *(volatile uint*)&r->tail;
+    __sync_synchronize();
+    while(head != tail && tot < n){
+      // the records up to the end of buf, or to tail.
+      m = NTRACEREC - head % NTRACEREC;
+      if(m > tail - head)
+        m = tail - head;
+      if(m > n - tot)
+        m = n - tot;
+      if(copyout(myproc()->pagetable, addr + tot*sizeof(struct trec),
+                 (char*)&r->buf[head % NTRACEREC], m*sizeof(struct trec)) < 0)
+        return -1;
+      head += m;
+      tot += m;
+    }
+    // done reading the slots before the CPU may reuse them.
+    __sync_synchronize();
+    r->head = head;
+  }
+  return tot;
+}
+
+int
+ktrace(int cmd, uint64 addr, int n)
+{
+  struct tracering *r;
+  int ret;
+
+  acquire(&tracelock);
+  switch(cmd){
+  case TRACE_START:
+    tracing = 0;
+    for(r = rings; r < rings + NCPU; r++){
+      r->head = *(volatile uint*)&r->tail;
+      r->ndrop = 0;
+    }
+    __sync_synchronize();
+    tracing = 1;
+    ret = 0;
+    break;
+  case TRACE_STOP:
+    tracing = 0;
+    ret = 0;
+    for(r = rings; r < rings + NCPU; r++)
+      ret += r->ndrop;
+    break;
+  case TRACE_READ:
+    ret = n < 0 ? -1 : traceread(addr, n);
+    break;
+  default:
+    ret = -1;
+  }
+  release(&tracelock);
+  return ret;
+}
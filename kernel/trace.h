@@ -0,0 +1,27 @@
+// Trace commands and records, for ktrace().
+// Both the kernel and user programs use this header file.
+
+#define TRACE_START 1  // discard old records and start tracing
+#define TRACE_STOP  2  // stop tracing; returns records dropped
+#define TRACE_READ  3  // copy out and remove buffered records
+
+// record types, with the meaning of a0 and a1.
+#define TR_SYSENTER   1  // system call number
+#define TR_SYSEXIT    2  // system call number, return value
+#define TR_SWITCHIN   3  // scheduler() switches to pid a0
+#define TR_SWITCHOUT  4  // pid a0 gives up the CPU in state a1
+#define TR_SLEEP      5  // channel
+#define TR_WAKEUP     6  // channel, pid woken
+#define TR_BREAD      7  // block number, 1 if cached
+#define TR_BWRITE     8  // block number
+#define TR_DISKSUBMIT 9  // block number, 1 if a write
+#define TR_DISKDONE  10  // block number
+
+struct trec {
+  uint64 time;    // the time CSR
+  ushort type;    // TR_*
+  ushort cpu;
+  int pid;        // running process, or 0 if none
+  uint64 a0;
+  uint64 a1;
+};
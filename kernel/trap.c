@@ -3,14 +3,21 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 #include "defs.h"
 
 struct spinlock tickslock;
 uint ticks;
 
+// mapped read-only at USHARED in every process.
+struct ushared *ushared;
+
 extern char trampoline[], uservec[], userret[];
 
+// in vmcopyin.S.
+extern char copyuserend[], copyfault[];
+
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
@@ -20,6 +27,9 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  if((ushared = (struct ushared*)kalloc()) == 0)
+    panic("trapinit");
+  pagezero(ushared);
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -68,6 +78,8 @@ usertrap(void)
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
+    if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15)
+      p->ru.nfault++;
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
     p->killed = 1;
@@ -143,7 +155,19 @@ kerneltrap()
   if(intr_get() != 0)
     panic("kerneltrap: interrupts enabled");
 
-  if((which_dev = devintr()) == 0){
+  // the trap may have interrupted copyuser() with SUM set.
+  // clear it while handling the trap, so that it doesn't
+  // stay set for whatever runs here if we yield; the
+  // w_sstatus() below puts it back.
+  w_sstatus(sstatus & ~SSTATUS_SUM);
+
+  if((scause == 13 || scause == 15) &&
+     sepc >= (uint64)copyuser && sepc < (uint64)copyuserend){
+    // copyin() or copyout() hit an unmapped user page;
+    // make the copy return -1.
+    sepc = (uint64)copyfault;
+    myproc()->ru.nfault++;
+  } else if((which_dev = devintr()) == 0){
     printf("scause %p\n", scause);
     printf("sepc=%p stval=%p\n", r_sepc(), r_stval());
     panic("kerneltrap");
@@ -164,6 +188,7 @@ clockintr()
 {
   acquire(&tickslock);
   ticks++;
+  ushared->ticks = ticks;
   wakeup(&ticks);
   release(&tickslock);
 }
@@ -177,6 +202,7 @@ int
 devintr()
 {
   uint64 scause = r_scause();
+  struct proc *p;
 
   if((scause & 0x8000000000000000L) &&
      (scause & 0xff) == 9){
@@ -207,6 +233,17 @@ devintr()
     if(cpuid() == 0){
       clockintr();
     }
+
+    // charge the tick to the process it interrupted.
+    if((p = myproc()) != 0){
+      if(r_sstatus() & SSTATUS_SPP)
+        p->ru.stime++;
+      else
+        p->ru.utime++;
+    }
+
+    if(profiling)
+      profsample();
     
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
@@ -7,6 +7,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rusage.h"
 #include "proc.h"
 #include "defs.h"
 
@@ -38,16 +39,24 @@
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
+#define UART_FIFO_SIZE 16     // bytes the transmit FIFO holds
+
 // the transmit output buffer.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
+#define UART_TX_BUF_SIZE 1024
 char uart_tx_buf[UART_TX_BUF_SIZE];
-int uart_tx_w; // write next to uart_tx_buf[uart_tx_w++]
-int uart_tx_r; // read next from uart_tx_buf[uar_tx_r++]
+uint uart_tx_w; // write next to uart_tx_buf[uart_tx_w++ % UART_TX_BUF_SIZE]
+uint uart_tx_r; // read next from uart_tx_buf[uart_tx_r++ % UART_TX_BUF_SIZE]
+
+// kernel printf() output taken from klogtx(), being sent.
+// also protected by uart_tx_lock.
+char uart_log_buf[32];
+int uart_log_n;   // bytes in uart_log_buf
+int uart_log_r;   // next to send
 
 extern volatile int panicked; // from printf.c
 
-void uartstart();
+int uartstart();
 
 void
 uartinit(void)
@@ -77,15 +86,17 @@ uartinit(void)
   initlock(&uart_tx_lock, "uart");
 }
 
-// add a character to the output buffer and tell the
-// UART to start sending if it isn't already.
-// blocks if the output buffer is full.
+// add n bytes from buf to the output buffer and tell
+// the UART to start sending if it isn't already.
+// blocks while the output buffer is full.
 // because it may block, it can't be called
 // from interrupts; it's only suitable for use
 // by write().
 void
-uartputc(int c)
+uartwrite(char *buf, int n)
 {
+  int i, sent;
+
   acquire(&uart_tx_lock);
 
   if(panicked){
@@ -93,23 +104,29 @@ uartputc(int c)
       ;
   }
 
-  while(1){
-    if(((uart_tx_w + 1) % UART_TX_BUF_SIZE) == uart_tx_r){
+  sent = 0;
+  i = 0;
+  while(i < n){
+    if(uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE){
       // buffer is full.
       // wait for uartstart() to open up space in the buffer.
       sleep(&uart_tx_r, &uart_tx_lock);
-    } else {
-      uart_tx_buf[uart_tx_w] = c;
-      uart_tx_w = (uart_tx_w + 1) % UART_TX_BUF_SIZE;
-      uartstart();
-      release(&uart_tx_lock);
-      return;
+      continue;
     }
+    while(i < n && uart_tx_w != uart_tx_r + UART_TX_BUF_SIZE)
+      uart_tx_buf[uart_tx_w++ % UART_TX_BUF_SIZE] = buf[i++];
+    sent |= uartstart();
   }
+
+  release(&uart_tx_lock);
+
+  // maybe another uartwrite() is waiting for space.
+  if(sent)
+    wakeup(&uart_tx_r);
 }
 
-// alternate version of uartputc() that doesn't 
-// use interrupts, for use by kernel printf() and
+// alternate version of uartwrite() that doesn't 
+// use interrupts, for use by panic() and
 // to echo characters. it spins waiting for the uart's
 // output register to be empty.
 void
@@ -130,36 +147,80 @@ uartputc_sync(int c)
   pop_off();
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
+// fill the UART's transmit FIFO, whenever it is empty,
+// with kernel printf() output and then, if user is set,
+// bytes from the transmit buffer.
+// returns 1 if it took bytes from the transmit buffer.
 // caller must hold uart_tx_lock.
-// called from both the top- and bottom-half.
-void
-uartstart()
+static int
+uartfill(int user)
 {
+  int i, c, sent = 0;
+
   while(1){
-    if(uart_tx_w == uart_tx_r){
-      // transmit buffer is empty.
-      return;
-    }
-    
     if((ReadReg(LSR) & LSR_TX_IDLE) == 0){
-      // the UART transmit holding register is full,
-      // so we cannot give it another byte.
-      // it will interrupt when it's ready for a new byte.
-      return;
+      // the UART is still sending the last burst.
+      // it will interrupt when it's ready for more.
+      return sent;
+    }
+
+    // the transmit FIFO is empty.
+    for(i = 0; i < UART_FIFO_SIZE; i++){
+      if(uart_log_r == uart_log_n){
+        uart_log_r = 0;
+        uart_log_n = klogtx(uart_log_buf, sizeof(uart_log_buf));
+      }
+      if(uart_log_r < uart_log_n){
+        c = uart_log_buf[uart_log_r++];
+      } else if(user && uart_tx_r != uart_tx_w){
+        c = uart_tx_buf[uart_tx_r++ % UART_TX_BUF_SIZE];
+        sent = 1;
+      } else {
+        break;
+      }
+      WriteReg(THR, c);
+    }
+    if(i == 0){
+      // nothing left to send.
+      return sent;
     }
-    
-    int c = uart_tx_buf[uart_tx_r];
-    uart_tx_r = (uart_tx_r + 1) % UART_TX_BUF_SIZE;
-    
-    // maybe uartputc() is waiting for space in the buffer.
-    wakeup(&uart_tx_r);
-    
-    WriteReg(THR, c);
   }
 }
 
+// start sending new kernel printf() output, if the UART
+// is idle; its transmit interrupts will send the rest.
+// called by printf(), perhaps while holding other locks;
+// nothing calls wakeup() while holding uart_tx_lock, so
+// that's safe.
+void
+uartkick(void)
+{
+  push_off();
+  if(holding(&uart_tx_lock)){
+    // this CPU is in uartstart(), which will send it.
+    pop_off();
+    return;
+  }
+  acquire(&uart_tx_lock);
+  pop_off();
+  uartfill(0);
+  release(&uart_tx_lock);
+}
+
+// if the UART is idle, and characters are waiting
+// in the transmit buffer, send a burst of them.
+// kernel printf() output goes first.
+// caller must hold uart_tx_lock.
+// called from both the top- and bottom-half.
+// returns 1 if it made space in the buffer; the caller
+// should then wakeup(&uart_tx_r) after releasing
+// uart_tx_lock, in case uartwrite() is waiting.
+int
+uartstart()
+{
+  return uartfill(1);
+}
+
 // read one input character from the UART.
 // return -1 if none is waiting.
 int
@@ -189,6 +250,10 @@ uartintr(void)
 
   // send buffered characters.
   acquire(&uart_tx_lock);
-  uartstart();
+  int sent = uartstart();
   release(&uart_tx_lock);
+
+  // maybe uartwrite() is waiting for space in the buffer.
+  if(sent)
+    wakeup(&uart_tx_r);
 }
@@ -0,0 +1,6 @@
+// Scatter/gather buffer descriptor for readv() and writev().
+// Both the kernel and user programs use this header file.
+struct iovec {
+  void *iov_base;   // start of buffer
+  uint64 iov_len;   // size of buffer (bytes)
+};
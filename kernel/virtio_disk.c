@@ -1,9 +1,18 @@
 //
 // driver for qemu's virtio disk device.
 // uses qemu's mmio interface to virtio.
-// qemu presents a "legacy" virtio interface.
+// uses the modern (virtio 1.x) interface, with
+// VIRTIO_RING_F_EVENT_IDX so that the driver and
+// device only signal each other when the other side
+// isn't already looking at the ring.
+// uses one virtqueue per hart if the device
+// offers VIRTIO_BLK_F_MQ (qemu's num-queues=).
+// requests come from iosched.c, which keeps a queue
+// for each virtqueue and may merge several adjacent
+// blocks into one request. they don't wait here;
+// iosched_done() learns of completions.
 //
-// qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
+// qemu ... -global virtio-mmio.force-legacy=false -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0,num-queues=3
 //
 
 #include "types.h"
@@ -16,109 +25,175 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "trace.h"
+#include "diskstat.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
 
-static struct disk {
- // memory for virtio descriptors &c for queue 0.
- // this is a global instead of allocated because it must
- // be multiple contiguous pages, which kalloc()
- // doesn't support, and page aligned.
-  char pages[2*PGSIZE];
-  struct VRingDesc *desc;
-  uint16 *avail;
-  struct UsedArea *used;
+// one virtqueue. with the multiqueue feature the device
+// has several, and each hart submits to its own, so
+// harts don't contend for one lock or descriptor pool.
+struct vqueue {
+  // the rings the driver and device share. the modern
+  // interface lets each live anywhere, given alignment,
+  // and they are in kernel memory, which is direct mapped.
+  struct virtq_desc desc[NUM] __attribute__ ((aligned (16)));
+  struct virtq_avail avail __attribute__ ((aligned (2)));
+  struct virtq_used used __attribute__ ((aligned (4)));
 
   // our own book-keeping.
   char free[NUM];  // is a descriptor free?
-  uint16 used_idx; // we've looked this far in used[2..NUM].
+  uint16 used_idx; // we've looked this far in used.ring.
 
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
   // indexed by first descriptor index of chain.
   struct {
-    struct buf *b;
+    struct buf *b;  // first block; the rest follow b->qnext
     char status;
   } info[NUM];
-  
-  struct spinlock vdisk_lock;
-  
-} __attribute__ ((aligned (PGSIZE))) disk;
+
+  // disk command headers, one-for-one with descriptors,
+  // for convenience.
+  struct virtio_blk_req ops[NUM];
+
+  int qid;         // queue number, for QUEUE_NOTIFY
+  struct spinlock lock;
+
+  // counters for diskstat(), protected by lock.
+  uint64 nio;
+  uint64 ncomplete;
+  uint64 nnotify;
+  uint64 nnotifyskip;
+};
+
+static struct disk {
+  struct vqueue q[NCPU];
+  int nqueue;      // queues in use
+  uint64 nintr;    // the PLIC delivers one interrupt at a time
+} disk;
+
+// set up queue number qid.
+static void
+vqueue_init(struct vqueue *q, int qid)
+{
+  initlock(&q->lock, "virtio_disk");
+  q->qid = qid;
+
+  *R(VIRTIO_MMIO_QUEUE_SEL) = qid;
+  if(*R(VIRTIO_MMIO_QUEUE_READY))
+    panic("virtio disk queue should not be ready");
+  uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
+  if(max == 0)
+    panic("virtio disk has no queue");
+  if(max < NUM)
+    panic("virtio disk max queue too short");
+  *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
+
+  memset(q->desc, 0, sizeof(q->desc));
+  memset(&q->avail, 0, sizeof(q->avail));
+  memset(&q->used, 0, sizeof(q->used));
+
+  // tell the device where the rings are.
+  *R(VIRTIO_MMIO_QUEUE_DESC_LOW) = (uint64)q->desc;
+  *R(VIRTIO_MMIO_QUEUE_DESC_HIGH) = (uint64)q->desc >> 32;
+  *R(VIRTIO_MMIO_DRIVER_DESC_LOW) = (uint64)&q->avail;
+  *R(VIRTIO_MMIO_DRIVER_DESC_HIGH) = (uint64)&q->avail >> 32;
+  *R(VIRTIO_MMIO_DEVICE_DESC_LOW) = (uint64)&q->used;
+  *R(VIRTIO_MMIO_DEVICE_DESC_HIGH) = (uint64)&q->used >> 32;
+
+  *R(VIRTIO_MMIO_QUEUE_READY) = 1;
+
+  for(int i = 0; i < NUM; i++)
+    q->free[i] = 1;
+}
 
 void
 virtio_disk_init(void)
 {
   uint32 status = 0;
 
-  initlock(&disk.vdisk_lock, "virtio_disk");
-
   if(*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
-     *R(VIRTIO_MMIO_VERSION) != 1 ||
+     *R(VIRTIO_MMIO_VERSION) != 2 ||
      *R(VIRTIO_MMIO_DEVICE_ID) != 2 ||
      *R(VIRTIO_MMIO_VENDOR_ID) != 0x554d4551){
     panic("could not find virtio disk");
   }
-  
+
+  // reset device
+  *R(VIRTIO_MMIO_STATUS) = status;
+
   status |= VIRTIO_CONFIG_S_ACKNOWLEDGE;
   *R(VIRTIO_MMIO_STATUS) = status;
 
   status |= VIRTIO_CONFIG_S_DRIVER;
   *R(VIRTIO_MMIO_STATUS) = status;
 
-  // negotiate features
-  uint64 features = *R(VIRTIO_MMIO_DEVICE_FEATURES);
-  features &= ~(1 << VIRTIO_BLK_F_RO);
-  features &= ~(1 << VIRTIO_BLK_F_SCSI);
-  features &= ~(1 << VIRTIO_BLK_F_CONFIG_WCE);
-  features &= ~(1 << VIRTIO_BLK_F_MQ);
-  features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
-  features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
-  features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
+  // negotiate features. the modern interface has
+  // 64 feature bits, read and written 32 at a time.
+  uint64 features;
+  *R(VIRTIO_MMIO_DEVICE_FEATURES_SEL) = 1;
+  features = (uint64)*R(VIRTIO_MMIO_DEVICE_FEATURES) << 32;
+  *R(VIRTIO_MMIO_DEVICE_FEATURES_SEL) = 0;
+  features |= *R(VIRTIO_MMIO_DEVICE_FEATURES);
+  if((features & (1L << VIRTIO_F_VERSION_1)) == 0)
+    panic("virtio disk is not modern");
+  features &= ~(1L << VIRTIO_BLK_F_RO);
+  features &= ~(1L << VIRTIO_BLK_F_SCSI);
+  features &= ~(1L << VIRTIO_BLK_F_CONFIG_WCE);
+  features &= ~(1L << VIRTIO_F_ANY_LAYOUT);
+  features &= ~(1L << VIRTIO_RING_F_INDIRECT_DESC);
+  features &= (1L << VIRTIO_F_VERSION_1) |
+              (1L << VIRTIO_RING_F_EVENT_IDX) |
+              (1L << VIRTIO_BLK_F_MQ);
+  *R(VIRTIO_MMIO_DRIVER_FEATURES_SEL) = 1;
+  *R(VIRTIO_MMIO_DRIVER_FEATURES) = features >> 32;
+  *R(VIRTIO_MMIO_DRIVER_FEATURES_SEL) = 0;
   *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
 
   // tell device that feature negotiation is complete.
   status |= VIRTIO_CONFIG_S_FEATURES_OK;
   *R(VIRTIO_MMIO_STATUS) = status;
 
+  // re-read status to ensure FEATURES_OK is set.
+  status = *R(VIRTIO_MMIO_STATUS);
+  if(!(status & VIRTIO_CONFIG_S_FEATURES_OK))
+    panic("virtio disk FEATURES_OK unset");
+
+  // the rest of this driver counts on the event indices.
+  if((features & (1L << VIRTIO_RING_F_EVENT_IDX)) == 0)
+    panic("virtio disk lacks EVENT_IDX");
+
+  // one queue per hart, if the device has enough.
+  disk.nqueue = 1;
+  if(features & (1L << VIRTIO_BLK_F_MQ)){
+    disk.nqueue = *(volatile uint16 *)R(VIRTIO_MMIO_CONFIG + VIRTIO_BLK_CONFIG_NUM_QUEUES);
+    if(disk.nqueue > NCPU)
+      disk.nqueue = NCPU;
+    if(disk.nqueue < 1)
+      disk.nqueue = 1;
+  }
+
+  if(IOINFLIGHT*(IOMAXMERGE+2) > NUM)
+    panic("virtio disk NUM too small");
+  for(int i = 0; i < disk.nqueue; i++)
+    vqueue_init(&disk.q[i], i);
+
   // tell device we're completely ready.
   status |= VIRTIO_CONFIG_S_DRIVER_OK;
   *R(VIRTIO_MMIO_STATUS) = status;
 
-  *R(VIRTIO_MMIO_GUEST_PAGE_SIZE) = PGSIZE;
-
-  // initialize queue 0.
-  *R(VIRTIO_MMIO_QUEUE_SEL) = 0;
-  uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
-  if(max == 0)
-    panic("virtio disk has no queue 0");
-  if(max < NUM)
-    panic("virtio disk max queue too short");
-  *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
-  memset(disk.pages, 0, sizeof(disk.pages));
-  *R(VIRTIO_MMIO_QUEUE_PFN) = ((uint64)disk.pages) >> PGSHIFT;
-
-  // desc = pages -- num * VRingDesc
-  // avail = pages + 0x40 -- 2 * uint16, then num * uint16
-  // used = pages + 4096 -- 2 * uint16, then num * vRingUsedElem
-
-  disk.desc = (struct VRingDesc *) disk.pages;
-  disk.avail = (uint16*)(((char*)disk.desc) + NUM*sizeof(struct VRingDesc));
-  disk.used = (struct UsedArea *) (disk.pages + PGSIZE);
-
-  for(int i = 0; i < NUM; i++)
-    disk.free[i] = 1;
-
   // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
 }
 
 // find a free descriptor, mark it non-free, return its index.
 static int
-alloc_desc()
+alloc_desc(struct vqueue *q)
 {
   for(int i = 0; i < NUM; i++){
-    if(disk.free[i]){
-      disk.free[i] = 0;
+    if(q->free[i]){
+      q->free[i] = 0;
       return i;
     }
   }
@@ -127,144 +202,210 @@ alloc_desc()
 
 // mark a descriptor as free.
 static void
-free_desc(int i)
+free_desc(struct vqueue *q, int i)
 {
   if(i >= NUM)
     panic("virtio_disk_intr 1");
-  if(disk.free[i])
+  if(q->free[i])
     panic("virtio_disk_intr 2");
-  disk.desc[i].addr = 0;
-  disk.free[i] = 1;
-  wakeup(&disk.free[0]);
+  q->desc[i].addr = 0;
+  q->free[i] = 1;
 }
 
 // free a chain of descriptors.
 static void
-free_chain(int i)
+free_chain(struct vqueue *q, int i)
 {
   while(1){
-    free_desc(i);
-    if(disk.desc[i].flags & VRING_DESC_F_NEXT)
-      i = disk.desc[i].next;
+    free_desc(q, i);
+    if(q->desc[i].flags & VRING_DESC_F_NEXT)
+      i = q->desc[i].next;
     else
       break;
   }
 }
 
+// allocate n descriptors.
 static int
-alloc3_desc(int *idx)
+alloc_descs(struct vqueue *q, int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
-    idx[i] = alloc_desc();
+  for(int i = 0; i < n; i++){
+    idx[i] = alloc_desc(q);
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
-        free_desc(idx[j]);
+        free_desc(q, idx[j]);
       return -1;
     }
   }
   return 0;
 }
 
+// how many virtqueues are in use? a hart uses
+// queue cpuid() % virtio_disk_nqueue().
+int
+virtio_disk_nqueue(void)
+{
+  return disk.nqueue;
+}
+
+// start a request on virtqueue qid for the n blocks
+// starting at b, linked through qnext, with consecutive
+// block numbers. does not wait; calls iosched_done(qid, b)
+// when it's done. the caller must not have more than
+// IOINFLIGHT requests outstanding on the queue, so
+// descriptors can't run out.
 void
-virtio_disk_rw(struct buf *b, int write)
+virtio_disk_start(int qid, struct buf *b, int n, int write)
 {
   uint64 sector = b->blockno * (BSIZE / 512);
+  struct vqueue *q;
+  int idx[IOMAXMERGE+2];
+  struct buf *bp;
+
+  if(n < 1 || n > IOMAXMERGE)
+    panic("virtio_disk_start");
 
-  acquire(&disk.vdisk_lock);
+  q = &disk.q[qid];
+  acquire(&q->lock);
 
-  // the spec says that legacy block operations use three
+  // the spec says that block operations use a chain of
   // descriptors: one for type/reserved/sector, one for
-  // the data, one for a 1-byte status result.
+  // each block of data, one for a 1-byte status result.
+  if(alloc_descs(q, idx, n+2) < 0)
+    panic("virtio_disk_start: no descriptors");
 
-  // allocate the three descriptors.
-  int idx[3];
-  while(1){
-    if(alloc3_desc(idx) == 0) {
-      break;
-    }
-    sleep(&disk.free[0], &disk.vdisk_lock);
-  }
-  
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
-
-  struct virtio_blk_outhdr {
-    uint32 type;
-    uint32 reserved;
-    uint64 sector;
-  } buf0;
+  struct virtio_blk_req *buf0 = &q->ops[idx[0]];
 
   if(write)
-    buf0.type = VIRTIO_BLK_T_OUT; // write the disk
+    buf0->type = VIRTIO_BLK_T_OUT; // write the disk
   else
-    buf0.type = VIRTIO_BLK_T_IN; // read the disk
-  buf0.reserved = 0;
-  buf0.sector = sector;
-
-  // buf0 is on a kernel stack, which is not direct mapped,
-  // thus the call to kvmpa().
-  disk.desc[idx[0]].addr = (uint64) kvmpa((uint64) &buf0);
-  disk.desc[idx[0]].len = sizeof(buf0);
-  disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
-  disk.desc[idx[0]].next = idx[1];
-
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+    buf0->type = VIRTIO_BLK_T_IN; // read the disk
+  buf0->reserved = 0;
+  buf0->sector = sector;
+
+  q->desc[idx[0]].addr = (uint64) buf0;
+  q->desc[idx[0]].len = sizeof(struct virtio_blk_req);
+  q->desc[idx[0]].flags = VRING_DESC_F_NEXT;
+  q->desc[idx[0]].next = idx[1];
+
+  bp = b;
+  for(int i = 1; i <= n; i++, bp = bp->qnext){
+    q->desc[idx[i]].addr = (uint64) bp->data;
+    q->desc[idx[i]].len = BSIZE;
+    if(write)
+      q->desc[idx[i]].flags = 0; // device reads b->data
+    else
+      q->desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes b->data
+    q->desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    q->desc[idx[i]].next = idx[i+1];
+  }
 
-  disk.info[idx[0]].status = 0;
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  q->info[idx[0]].status = 0xff; // device writes 0 on success
+  q->desc[idx[n+1]].addr = (uint64) &q->info[idx[0]].status;
+  q->desc[idx[n+1]].len = 1;
+  q->desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  q->desc[idx[n+1]].next = 0;
 
   // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
-
-  // avail[0] is flags
-  // avail[1] tells the device how far to look in avail[2...].
-  // avail[2...] are desc[] indices the device should process.
-  // we only tell device the first index in our chain of descriptors.
-  disk.avail[2 + (disk.avail[1] % NUM)] = idx[0];
+  q->info[idx[0]].b = b;
+
+  // tell the device the first index in our chain of descriptors.
+  uint16 old = q->avail.idx;
+  q->avail.ring[old % NUM] = idx[0];
   __sync_synchronize();
-  disk.avail[1] = disk.avail[1] + 1;
+  q->avail.idx = old + 1;
+  __sync_synchronize();
+  q->nio++;
+
+  // the device asks, in used.avail_event, to be told only
+  // once avail.idx moves past it; while it is still working
+  // through the ring, it will find this request by itself.
+  if(VRING_NEED_EVENT(q->used.avail_event, (uint16)(old + 1), old)){
+    *R(VIRTIO_MMIO_QUEUE_NOTIFY) = q->qid; // value is queue number
+    q->nnotify++;
+  } else {
+    q->nnotifyskip++;
+  }
+  TRACE(TR_DISKSUBMIT, b->blockno, write);
 
-  *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+  release(&q->lock);
+}
 
-  // Wait for virtio_disk_intr() to say request has finished.
-  while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
+// finish the requests the device has completed on q.
+static void
+vqueue_intr(struct vqueue *q)
+{
+  struct buf *done[NUM];
+  int ndone = 0;
+
+  acquire(&q->lock);
+
+  while(1){
+    while(q->used_idx != *(volatile uint16 *)&q->used.idx){
+      __sync_synchronize();
+      int id = q->used.ring[q->used_idx % NUM].id;
+
+      if(q->info[id].status != 0)
+        panic("virtio_disk_intr status");
+
+      TRACE(TR_DISKDONE, q->info[id].b->blockno, 0);
+      done[ndone++] = q->info[id].b;
+      q->info[id].b = 0;
+      free_chain(q, id);
+
+      q->used_idx += 1;
+      q->ncomplete++;
+    }
+
+    // ask for an interrupt only for completions after the
+    // ones we've seen; those that arrived while we looked
+    // didn't raise one. then look again, in case one
+    // arrived before the device saw the new used_event.
+    q->avail.used_event = q->used_idx;
+    __sync_synchronize();
+    if(q->used_idx == *(volatile uint16 *)&q->used.idx)
+      break;
   }
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+  release(&q->lock);
 
-  release(&disk.vdisk_lock);
+  // iosched_done() may start more requests, so
+  // call it without holding q->lock.
+  for(int i = 0; i < ndone; i++)
+    iosched_done(q->qid, done[i]);
 }
 
 void
 virtio_disk_intr()
 {
-  acquire(&disk.vdisk_lock);
-
-  while((disk.used_idx % NUM) != (disk.used->id % NUM)){
-    int id = disk.used->elems[disk.used_idx].id;
+  // the device has one interrupt for all queues.
+  // acknowledge it before looking at the queues, so
+  // that a completion that arrives while we look
+  // raises a new interrupt.
+  *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+  __sync_synchronize();
+  disk.nintr++;
 
-    if(disk.info[id].status != 0)
-      panic("virtio_disk_intr status");
-    
-    disk.info[id].b->disk = 0;   // disk is done with buf
-    wakeup(disk.info[id].b);
+  for(int i = 0; i < disk.nqueue; i++)
+    vqueue_intr(&disk.q[i]);
+}
 
-    disk.used_idx = (disk.used_idx + 1) % NUM;
+// add the driver's counters to *st.
+void
+virtio_disk_stat(struct diskstat *st)
+{
+  struct vqueue *q;
+
+  st->nqueue = disk.nqueue;
+  st->nintr = disk.nintr;
+  for(q = disk.q; q < disk.q + disk.nqueue; q++){
+    acquire(&q->lock);
+    st->nio += q->nio;
+    st->ncomplete += q->ncomplete;
+    st->nnotify += q->nnotify;
+    st->nnotifyskip += q->nnotifyskip;
+    release(&q->lock);
   }
-  *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
-
-  release(&disk.vdisk_lock);
 }
@@ -3,6 +3,9 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "rusage.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -22,7 +25,7 @@ void
 kvminit()
 {
   kernel_pagetable = (pagetable_t) kalloc();
-  memset(kernel_pagetable, 0, PGSIZE);
+  pagezero(kernel_pagetable);
 
   // uart registers
   kvmmap(UART0, UART0, PGSIZE, PTE_R | PTE_W);
@@ -56,6 +59,81 @@ kvminithart()
   sfence_vma();
 }
 
+// Create a kernel page table for a process. It has all of
+// the kernel's mappings, but leaves the addresses below
+// MAXUVA for the process's user memory (see kvmsync()),
+// and maps a new kernel stack at KSTACK, with nothing in
+// the page below it.
+// Only the top two levels are copied, plus a bottom-level
+// page for the stack; the rest is shared with kernel_pagetable.
+// Returns 0 if out of memory.
+pagetable_t
+kvmcreate(void)
+{
+  pagetable_t kpagetable, l1, l0;
+  char *kstack;
+
+  if((kpagetable = (pagetable_t) kalloc()) == 0)
+    return 0;
+  if((l1 = (pagetable_t) kalloc()) == 0){
+    kfree(kpagetable);
+    return 0;
+  }
+  if((l0 = (pagetable_t) kalloc()) == 0){
+    kfree(l1);
+    kfree(kpagetable);
+    return 0;
+  }
+  if((kstack = kalloc()) == 0){
+    kfree(l0);
+    kfree(l1);
+    kfree(kpagetable);
+    return 0;
+  }
+  pagecopy(kpagetable, kernel_pagetable);
+  pagecopy(l1, (void*)PTE2PA(kernel_pagetable[0]));
+  memset(l1, 0, PX(1, MAXUVA) * sizeof(pte_t));
+  pagezero(l0);
+  l0[PX(0, KSTACK)] = PA2PTE(kstack) | PTE_R | PTE_W | PTE_V;
+  l1[PX(1, KSTACK)] = PA2PTE(l0) | PTE_V;
+  kpagetable[0] = PA2PTE(l1) | PTE_V;
+  return kpagetable;
+}
+
+// Free a page table made by kvmcreate(), and its kernel stack.
+void
+kvmfree(pagetable_t kpagetable)
+{
+  pagetable_t l1, l0;
+
+  l1 = (pagetable_t)PTE2PA(kpagetable[0]);
+  l0 = (pagetable_t)PTE2PA(l1[PX(1, KSTACK)]);
+  kfree((void*)PTE2PA(l0[PX(0, KSTACK)]));
+  kfree((void*)l0);
+  kfree((void*)l1);
+  kfree((void*)kpagetable);
+}
+
+// Make the user memory mapped by pagetable visible through
+// the kernel page table kpagetable, by pointing it at the
+// user page table's bottom-level pages. Must be called after
+// the user page table changes, before the kernel relies on
+// kpagetable to reach the change.
+void
+kvmsync(pagetable_t kpagetable, pagetable_t pagetable)
+{
+  pagetable_t kl1, ul1;
+  int i;
+
+  kl1 = (pagetable_t)PTE2PA(kpagetable[0]);
+  ul1 = 0;
+  if(pagetable[0] & PTE_V)
+    ul1 = (pagetable_t)PTE2PA(pagetable[0]);
+  for(i = 0; i < PX(1, MAXUVA); i++)
+    kl1[i] = ul1 ? ul1[i] : 0;
+  sfence_vma();
+}
+
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page-table pages.
@@ -81,7 +159,7 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
     } else {
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
+      pagezero(pagetable);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -121,26 +199,6 @@ kvmmap(uint64 va, uint64 pa, uint64 sz, int perm)
     panic("kvmmap");
 }
 
-// translate a kernel virtual address to
-// a physical address. only needed for
-// addresses on the stack.
-// assumes va is page aligned.
-uint64
-kvmpa(uint64 va)
-{
-  uint64 off = va % PGSIZE;
-  pte_t *pte;
-  uint64 pa;
-  
-  pte = walk(kernel_pagetable, va, 0);
-  if(pte == 0)
-    panic("kvmpa");
-  if((*pte & PTE_V) == 0)
-    panic("kvmpa");
-  pa = PTE2PA(*pte);
-  return pa+off;
-}
-
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned. Returns 0 on success, -1 if walk() couldn't
@@ -203,7 +261,7 @@ uvmcreate()
   pagetable = (pagetable_t) kalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
+  pagezero(pagetable);
   return pagetable;
 }
 
@@ -218,7 +276,7 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
   mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  pagezero(mem);
   mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
   memmove(mem, src, sz);
 }
@@ -241,7 +299,7 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
+    pagezero(mem);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -322,7 +380,7 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
     flags = PTE_FLAGS(*pte);
     if((mem = kalloc()) == 0)
       goto err;
-    memmove(mem, (char*)pa, PGSIZE);
+    pagecopy(mem, (char*)pa);
     if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
       kfree(mem);
       goto err;
@@ -348,6 +406,16 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
+// Does [va, va+len) touch p's user stack guard page? It is
+// mapped without PTE_U, which the supervisor can reach through
+// p's kernel page table, so the copy fast paths below must
+// keep off it themselves.
+static int
+inguard(struct proc *p, uint64 va, uint64 len)
+{
+  return p->ustack != 0 && va < p->ustack && va + len > p->ustack - PGSIZE;
+}
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
@@ -355,6 +423,17 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  struct proc *p = myproc();
+
+  if(p != 0 && pagetable == p->pagetable){
+    // the current process's kernel page table maps
+    // its user memory, so copy directly.
+    if(dstva + len < dstva || dstva + len > p->sz)
+      return -1;
+    if(inguard(p, dstva, len))
+      return -1;
+    return copyuser((void*)dstva, src, len);
+  }
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
@@ -380,6 +459,15 @@ int
 copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
+  struct proc *p = myproc();
+
+  if(p != 0 && pagetable == p->pagetable){
+    if(srcva + len < srcva || srcva + len > p->sz)
+      return -1;
+    if(inguard(p, srcva, len))
+      return -1;
+    return copyuser(dst, (void*)srcva, len);
+  }
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
@@ -407,6 +495,21 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
   uint64 n, va0, pa0;
   int got_null = 0;
+  struct proc *p = myproc();
+
+  if(p != 0 && pagetable == p->pagetable){
+    if(srcva >= p->sz)
+      return -1;
+    if(max > p->sz - srcva)
+      max = p->sz - srcva;
+    // the string must end before the guard page, if it
+    // starts below it.
+    if(inguard(p, srcva, 1))
+      return -1;
+    if(inguard(p, srcva, max))
+      max = p->ustack - PGSIZE - srcva;
+    return copyuserstr(dst, (char*)srcva, max) == 0 ? 0 : -1;
+  }
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
@@ -2,11 +2,10 @@
 #include "user/user.h"
 
 int main(){
-    char buf[64];
+    // move standard input to standard output inside the kernel.
     while(1){
-        int n = read(0, buf, sizeof(buf));
+        int n = splice(0, 1, 4096);
         if(n<=0) break;
-        write(1, buf, n);
     }
     exit(0);
 }
\ No newline at end of file
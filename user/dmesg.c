@@ -0,0 +1,21 @@
+// Print the kernel's recent console output.
+//
+// usage: dmesg
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+char buf[16384];
+
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  if((n = dmesg(buf, sizeof(buf))) < 0){
+    fprintf(2, "dmesg: failed\n");
+    exit(1);
+  }
+  write(1, buf, n);
+  exit(0);
+}
@@ -1,6 +1,7 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "user/user.h"
+#include "user/stdio.h"
 #include "kernel/fs.h"
 
 int matchhere(char*, char*);
@@ -49,6 +50,7 @@ find(char *dir, char *name)
   int fd;
   struct dirent de;
   struct stat st;
+  FILE *dp;
 
   if((fd = open(dir, 0)) < 0){
     fprintf(2, "find: cannot open %s\n", dir);
@@ -73,10 +75,16 @@ find(char *dir, char *name)
       printf("ls: path too long\n");
       break;
     }
+    // read the directory a buffer at a time, not one
+    // dirent per read().
+    if((dp = fdopen(fd, "r")) == 0){
+      fprintf(2, "find: cannot read %s\n", dir);
+      break;
+    }
     strcpy(buf, dir);
     p = buf+strlen(buf);
     *p++ = '/';
-    while(read(fd, &de, sizeof(de)) == sizeof(de)){
+    while(fread(&de, sizeof(de), 1, dp) == 1){
       if(de.inum == 0)
         continue;
       memmove(p, de.name, DIRSIZ);
@@ -90,7 +98,8 @@ find(char *dir, char *name)
         find(buf,name);
       }
     }
-    break;
+    fclose(dp);
+    return;
   }
   close(fd);
 }
@@ -3,32 +3,23 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "user/user.h"
+#include "user/stdio.h"
 
 char buf[1024];
 int match(char*, char*);
 
 void
-grep(char *pattern, int fd)
+grep(char *pattern, FILE *fp)
 {
-  int n, m;
-  char *p, *q;
+  char *q;
 
-  m = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
-    m += n;
-    buf[m] = '\0';
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
+  while(fgets(buf, sizeof(buf), fp) != 0){
+    if((q = strchr(buf, '\n')) != 0)
       *q = 0;
-      if(match(pattern, p)){
+    if(match(pattern, buf)){
+      if(q)
         *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
-    }
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
+      fputs(buf, stdout);
     }
   }
 }
@@ -37,8 +28,9 @@ grep(char *pattern, int fd)
 int
 main(int argc, char *argv[])
 {
-  int fd, i;
+  int i;
   char *pattern;
+  FILE *fp;
 
   if(argc <= 1){
     fprintf(2, "usage: grep pattern [file ...]\n");
@@ -47,17 +39,17 @@ main(int argc, char *argv[])
   pattern = argv[1];
 
   if(argc <= 2){
-    grep(pattern, 0);
+    grep(pattern, stdin);
     exit(0);
   }
 
   for(i = 2; i < argc; i++){
-    if((fd = open(argv[i], 0)) < 0){
+    if((fp = fopen(argv[i], "r")) == 0){
       printf("grep: cannot open %s\n", argv[i]);
       exit(1);
     }
-    grep(pattern, fd);
-    close(fd);
+    grep(pattern, fp);
+    fclose(fp);
   }
   exit(0);
 }
@@ -0,0 +1,80 @@
+// Show the disk driver's counters.
+//
+// usage: iostat              counters since boot
+//        iostat cmd [arg ...] counters while cmd runs
+//
+// With EVENT_IDX the driver and device only signal each
+// other when the other side isn't already busy with the
+// ring, so under load intr/io and notify/io fall below 1.
+// The I/O scheduler merges adjacent blocks into one
+// request, so block/io rises above 1.
+
+#include "kernel/types.h"
+#include "kernel/diskstat.h"
+#include "user/user.h"
+
+void
+get(struct diskstat *st)
+{
+  if(diskstat(st) < 0){
+    fprintf(2, "iostat: diskstat failed\n");
+    exit(1);
+  }
+}
+
+// print x/y with two decimal places.
+void
+ratio(char *name, uint64 x, uint64 y)
+{
+  uint64 r;
+
+  r = y ? x * 100 / y : 0;
+  printf("%s %l.%l%l\n", name, r / 100, r / 10 % 10, r % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct diskstat st0, st;
+  int pid;
+
+  memset(&st0, 0, sizeof(st0));
+  if(argc > 1){
+    get(&st0);
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "iostat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "iostat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+  get(&st);
+
+  st.nio -= st0.nio;
+  st.ncomplete -= st0.ncomplete;
+  st.nintr -= st0.nintr;
+  st.nnotify -= st0.nnotify;
+  st.nnotifyskip -= st0.nnotifyskip;
+  st.nblock -= st0.nblock;
+  st.nmerged -= st0.nmerged;
+  st.nexpired -= st0.nexpired;
+
+  printf("queues %l\n", st.nqueue);
+  printf("block %l\n", st.nblock);
+  printf("merged %l\n", st.nmerged);
+  printf("expired %l\n", st.nexpired);
+  printf("io %l\n", st.nio);
+  printf("complete %l\n", st.ncomplete);
+  printf("intr %l\n", st.nintr);
+  printf("notify %l\n", st.nnotify);
+  printf("notifyskip %l\n", st.nnotifyskip);
+  ratio("block/io", st.nblock, st.nio);
+  ratio("intr/io", st.nintr, st.nio);
+  ratio("notify/io", st.nnotify, st.nio);
+  exit(0);
+}
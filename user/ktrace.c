@@ -0,0 +1,268 @@
+// Print a timeline of the kernel's tracepoints.
+//
+// usage: ktrace cmd [arg ...]   trace while cmd runs
+//        ktrace start           start tracing
+//        ktrace stop            stop tracing and print
+//
+// Each line is the time in microseconds since the first
+// record, the CPU, the pid running on it, and the event.
+// System call exits also show how long the call took, and
+// a table of time per system call follows the timeline.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define NBATCH  256
+#define NREC    (NCPU*2048)  // enough for full rings on every CPU
+#define NSYS    64
+#define NPEND   64           // processes in a system call at once
+#define TICKUS  10           // time CSR ticks per microsecond in qemu
+
+char *sysnames[NSYS] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_splice]  "splice",
+[SYS_readv]   "readv",
+[SYS_writev]  "writev",
+[SYS_pread]   "pread",
+[SYS_pwrite]  "pwrite",
+[SYS_ringenter] "ringenter",
+[SYS_lockstat] "lockstat",
+[SYS_prof]    "prof",
+[SYS_ktrace]  "ktrace",
+[SYS_getrusage] "getrusage",
+[SYS_dmesg]   "dmesg",
+[SYS_ioctl]   "ioctl",
+[SYS_diskstat] "diskstat",
+[SYS_fsync]   "fsync",
+[SYS_sync]    "sync",
+};
+
+char *states[] = { "unused", "sleeping", "runnable", "running", "zombie" };
+
+struct trec *recs;
+int nrec;
+
+// when each process in a system call entered it.
+struct {
+  int pid;
+  uint64 time;
+} pend[NPEND];
+
+struct {
+  int n;
+  uint64 total;
+  uint64 max;
+} sysstat[NSYS];
+
+char*
+sysname(uint64 num)
+{
+  if(num < NSYS && sysnames[num])
+    return sysnames[num];
+  return "?";
+}
+
+// Read every buffered record into recs.
+void
+readall(void)
+{
+  int n;
+
+  if((recs = malloc(NREC * sizeof(struct trec))) == 0){
+    fprintf(2, "ktrace: out of memory\n");
+    exit(1);
+  }
+  while(nrec < NREC){
+    n = NREC - nrec;
+    if(n > NBATCH)
+      n = NBATCH;
+    if((n = ktrace(TRACE_READ, recs + nrec, n)) < 0){
+      fprintf(2, "ktrace: read failed\n");
+      exit(1);
+    }
+    if(n == 0)
+      break;
+    nrec += n;
+  }
+}
+
+// Merge the per-CPU runs of records into one timeline.
+// ktrace() returns each CPU's records in order, one CPU
+// after another.
+void
+merge(void)
+{
+  struct trec *out;
+  int start[NCPU+1], next[NCPU], nrun, i, j, best;
+
+  nrun = 0;
+  for(i = 0; i < nrec; i++){
+    if(i == 0 || (recs[i].cpu != recs[i-1].cpu && nrun < NCPU))
+      start[nrun++] = i;
+  }
+  start[nrun] = nrec;
+  if(nrun <= 1)
+    return;
+
+  if((out = malloc(nrec * sizeof(struct trec))) == 0){
+    fprintf(2, "ktrace: out of memory\n");
+    exit(1);
+  }
+  for(j = 0; j < nrun; j++)
+    next[j] = start[j];
+  for(i = 0; i < nrec; i++){
+    best = -1;
+    for(j = 0; j < nrun; j++){
+      if(next[j] < start[j+1] &&
+         (best < 0 || recs[next[j]].time < recs[next[best]].time))
+        best = j;
+    }
+    out[i] = recs[next[best]++];
+  }
+  free(recs);
+  recs = out;
+}
+
+// How long the system call that pid just left took.
+uint64
+sysdone(int pid, uint64 time)
+{
+  int i;
+
+  i = pid % NPEND;
+  if(pend[i].pid != pid)
+    return 0;
+  pend[i].pid = 0;
+  return time - pend[i].time;
+}
+
+void
+show(struct trec *t, uint64 t0)
+{
+  uint64 d;
+
+  printf("%l %d %d ", (t->time - t0) / TICKUS, t->cpu, t->pid);
+  switch(t->type){
+  case TR_SYSENTER:
+    pend[t->pid % NPEND].pid = t->pid;
+    pend[t->pid % NPEND].time = t->time;
+    printf("syscall %s\n", sysname(t->a0));
+    break;
+  case TR_SYSEXIT:
+    d = sysdone(t->pid, t->time);
+    printf("sysret %s = %d (%l us)\n", sysname(t->a0), (int)t->a1, d / TICKUS);
+    if(t->a0 < NSYS){
+      sysstat[t->a0].n++;
+      sysstat[t->a0].total += d;
+      if(d > sysstat[t->a0].max)
+        sysstat[t->a0].max = d;
+    }
+    break;
+  case TR_SWITCHIN:
+    printf("switch to %d\n", (int)t->a0);
+    break;
+  case TR_SWITCHOUT:
+    printf("switch from %d, %s\n", (int)t->a0,
+           t->a1 < sizeof(states)/sizeof(states[0]) ? states[t->a1] : "?");
+    break;
+  case TR_SLEEP:
+    printf("sleep %p\n", t->a0);
+    break;
+  case TR_WAKEUP:
+    printf("wakeup %p pid %d\n", t->a0, (int)t->a1);
+    break;
+  case TR_BREAD:
+    printf("bread %d%s\n", (int)t->a0, t->a1 ? " cached" : "");
+    break;
+  case TR_BWRITE:
+    printf("bwrite %d\n", (int)t->a0);
+    break;
+  case TR_DISKSUBMIT:
+    printf("disk %s %d\n", t->a1 ? "write" : "read", (int)t->a0);
+    break;
+  case TR_DISKDONE:
+    printf("disk done %d\n", (int)t->a0);
+    break;
+  default:
+    printf("type %d %p %p\n", t->type, t->a0, t->a1);
+  }
+}
+
+// Stop tracing and print what was recorded.
+void
+stop(void)
+{
+  int i, ndrop;
+
+  ndrop = ktrace(TRACE_STOP, 0, 0);
+  readall();
+  merge();
+  for(i = 0; i < nrec; i++)
+    show(&recs[i], recs[0].time);
+  printf("%d records, %d dropped\n", nrec, ndrop);
+
+  printf("\nsyscall calls total-us max-us\n");
+  for(i = 0; i < NSYS; i++){
+    if(sysstat[i].n > 0)
+      printf("%s %d %l %l\n", sysname(i), sysstat[i].n,
+             sysstat[i].total / TICKUS, sysstat[i].max / TICKUS);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc < 2){
+    fprintf(2, "usage: ktrace cmd [arg ...] | start | stop\n");
+    exit(1);
+  }
+  if(strcmp(argv[1], "stop") == 0){
+    stop();
+    exit(0);
+  }
+  if(ktrace(TRACE_START, 0, 0) < 0){
+    fprintf(2, "ktrace: start failed\n");
+    exit(1);
+  }
+  if(strcmp(argv[1], "start") == 0)
+    exit(0);
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "ktrace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "ktrace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  stop();
+  exit(0);
+}
@@ -0,0 +1,51 @@
+// Show the most contended kernel locks.
+//
+// usage: lockstat [-r] [n]
+//   -r  clear the counters after reading them
+//   n   how many lock names to show (default 10)
+
+#include "kernel/types.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+#define NINFO 64
+
+struct lockinfo info[NINFO];
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, nshow = 10, reset = 0;
+  struct lockinfo t;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-r") == 0)
+      reset = 1;
+    else if((nshow = atoi(argv[i])) <= 0){
+      fprintf(2, "usage: lockstat [-r] [n]\n");
+      exit(1);
+    }
+  }
+
+  if((n = lockstat(info, NINFO, reset)) < 0){
+    fprintf(2, "lockstat: failed\n");
+    exit(1);
+  }
+
+  // most contended first.
+  for(i = 1; i < n; i++){
+    t = info[i];
+    for(j = i; j > 0 && info[j-1].ncontend < t.ncontend; j--)
+      info[j] = info[j-1];
+    info[j] = t;
+  }
+
+  printf("name kind acquire contend spin sleep holdcycles\n");
+  for(i = 0; i < n && i < nshow; i++){
+    printf("%s %s %l %l %l %l %l\n", info[i].name,
+           info[i].sleep ? "sleep" : "spin",
+           info[i].nacquire, info[i].ncontend, info[i].nspin,
+           info[i].nsleep, info[i].holdcycles);
+  }
+  exit(0);
+}
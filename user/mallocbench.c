@@ -0,0 +1,105 @@
+// Time malloc() and free() under a few allocation patterns.
+//
+// usage: mallocbench [rounds]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define NSLOT 512
+
+static void *slot[NSLOT];
+static uint seed = 1;
+
+static uint
+rnd(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static void
+report(char *name, int ops, int t0)
+{
+  printf("%s: %d ops in %d ticks\n", name, ops, uptime() - t0);
+}
+
+// allocate and immediately free, as a parser does with
+// short-lived nodes.
+static void
+pairs(int rounds)
+{
+  int i, t0;
+  void *p;
+
+  t0 = uptime();
+  for(i = 0; i < rounds; i++){
+    p = malloc(16 + rnd() % 200);
+    free(p);
+  }
+  report("pairs", rounds, t0);
+}
+
+// keep NSLOT blocks of mixed sizes live and replace
+// one at random each step, fragmenting the heap.
+static void
+churn(int rounds)
+{
+  int i, j, t0;
+
+  t0 = uptime();
+  for(i = 0; i < rounds; i++){
+    j = rnd() % NSLOT;
+    free(slot[j]);
+    slot[j] = malloc(8 + rnd() % 1000);
+    if(slot[j] == 0){
+      printf("mallocbench: out of memory\n");
+      exit(1);
+    }
+  }
+  report("churn", rounds, t0);
+  for(j = 0; j < NSLOT; j++){
+    free(slot[j]);
+    slot[j] = 0;
+  }
+}
+
+// large blocks that come and go at the top of the heap.
+static void
+large(int rounds)
+{
+  int i, t0;
+  char *p;
+
+  t0 = uptime();
+  for(i = 0; i < rounds / 64; i++){
+    p = malloc(64*1024 + rnd() % 4096);
+    if(p == 0){
+      printf("mallocbench: out of memory\n");
+      exit(1);
+    }
+    p[0] = 1;
+    free(p);
+  }
+  report("large", rounds / 64, t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 200000;
+  struct mstats st;
+
+  if(argc > 1 && (rounds = atoi(argv[1])) <= 0){
+    fprintf(2, "usage: mallocbench [rounds]\n");
+    exit(1);
+  }
+
+  pairs(rounds);
+  churn(rounds);
+  large(rounds);
+
+  mstat(&st);
+  printf("malloc %l free %l inuse %l heap %l released %l\n",
+         st.nmalloc, st.nfree, st.inuse, st.heap, st.released);
+  exit(0);
+}
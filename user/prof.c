@@ -0,0 +1,232 @@
+// Sample where the CPUs spend their time.
+//
+// usage: prof cmd [arg ...]   profile while cmd runs
+//        prof start           start profiling
+//        prof stop            stop profiling and report
+//
+// Samples of kernel code are grouped by function, using the
+// symbols the build puts in /kernel.sym. Samples of user code
+// are grouped by pid and pc; look the pcs up in user/*.asm.
+
+#include "kernel/types.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+#include "user/stdio.h"
+
+#define NBATCH  256   // samples per prof() call
+#define NHIST   1024  // distinct pcs or functions counted
+#define NSHOW   20    // lines of each kind to show
+
+struct hist {
+  uint64 pc;
+  int pid;
+  int user;
+  uint64 sym;     // address of pc's kernel symbol
+  char name[32];  // and its name, or ""
+  int count;
+};
+
+struct sample batch[NBATCH];
+struct hist hist[NHIST];
+int nhist;
+
+// Count a sample. Kernel samples are counted by pc alone,
+// user samples by pid and pc.
+void
+count(struct sample *s)
+{
+  struct hist *h;
+  int pid;
+
+  pid = s->user ? s->pid : 0;
+  for(h = hist; h < hist + nhist; h++){
+    if(h->pc == s->pc && h->user == s->user && h->pid == pid){
+      h->count++;
+      return;
+    }
+  }
+  if(nhist == NHIST)
+    h = &hist[NHIST-1];  // the last slot counts the rest.
+  else {
+    h = &hist[nhist++];
+    h->pc = s->pc;
+    h->pid = pid;
+    h->user = s->user;
+  }
+  h->count++;
+}
+
+uint64
+hex(char *s)
+{
+  uint64 x;
+  int c;
+
+  for(x = 0; ; s++){
+    c = *s;
+    if(c >= '0' && c <= '9')
+      x = x*16 + c - '0';
+    else if(c >= 'a' && c <= 'f')
+      x = x*16 + c - 'a' + 10;
+    else
+      return x;
+  }
+}
+
+// Name each kernel pc after the nearest symbol at or below it,
+// from lines like "0000000080000000 _entry".
+void
+symbolize(void)
+{
+  FILE *fp;
+  char line[128], *name;
+  struct hist *h;
+  uint64 addr;
+  int n;
+
+  if((fp = fopen("/kernel.sym", "r")) == 0)
+    return;
+  while(fgets(line, sizeof(line), fp) != 0){
+    n = strlen(line);
+    if(n < 18 || line[16] != ' ')
+      continue;
+    if(line[n-1] == '\n')
+      line[n-1] = '\0';
+    name = line + 17;
+    if(name[0] == '.' || name[0] == '\0')
+      continue;  // a section, not a function.
+    addr = hex(line);
+    if((n = strlen(name)) >= sizeof(hist[0].name))
+      n = sizeof(hist[0].name) - 1;
+    for(h = hist; h < hist + nhist; h++){
+      if(!h->user && addr <= h->pc && addr >= h->sym){
+        h->sym = addr;
+        memmove(h->name, name, n);
+        h->name[n] = '\0';
+      }
+    }
+  }
+  fclose(fp);
+}
+
+// Fold kernel samples in the same function into one entry.
+void
+fold(void)
+{
+  struct hist *h, *g;
+  int n;
+
+  n = 0;
+  for(h = hist; h < hist + nhist; h++){
+    if(!h->user && h->name[0] != '\0'){
+      for(g = hist; g < hist + n; g++){
+        if(!g->user && strcmp(g->name, h->name) == 0){
+          g->count += h->count;
+          break;
+        }
+      }
+      if(g < hist + n)
+        continue;
+    }
+    hist[n++] = *h;
+  }
+  nhist = n;
+}
+
+void
+report(int ndrop)
+{
+  struct hist *h, t;
+  int i, j, n, total, nuser, user;
+
+  total = nuser = 0;
+  for(h = hist; h < hist + nhist; h++){
+    total += h->count;
+    if(h->user)
+      nuser += h->count;
+  }
+  printf("%d samples, %d user, %d kernel, %d dropped\n",
+         total, nuser, total - nuser, ndrop);
+  if(total == 0)
+    return;
+
+  // most samples first.
+  for(i = 1; i < nhist; i++){
+    t = hist[i];
+    for(j = i; j > 0 && hist[j-1].count < t.count; j--)
+      hist[j] = hist[j-1];
+    hist[j] = t;
+  }
+
+  for(user = 0; user < 2; user++){
+    printf("\n%s:\n", user ? "user pid pc" : "kernel");
+    n = 0;
+    for(h = hist; h < hist + nhist && n < NSHOW; h++){
+      if(h->user != user)
+        continue;
+      printf("%d %d%% ", h->count, h->count * 100 / total);
+      if(user)
+        printf("%d %p\n", h->pid, h->pc);
+      else if(h->name[0])
+        printf("%s\n", h->name);
+      else
+        printf("%p\n", h->pc);
+      n++;
+    }
+  }
+}
+
+// Stop profiling, drain the samples, and report.
+void
+stop(void)
+{
+  int i, n, ndrop;
+
+  ndrop = prof(PROF_STOP, 0, 0);
+  while((n = prof(PROF_READ, batch, NBATCH)) > 0){
+    for(i = 0; i < n; i++)
+      count(&batch[i]);
+  }
+  if(n < 0){
+    fprintf(2, "prof: read failed\n");
+    exit(1);
+  }
+  symbolize();
+  fold();
+  report(ndrop);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc < 2){
+    fprintf(2, "usage: prof cmd [arg ...] | start | stop\n");
+    exit(1);
+  }
+  if(strcmp(argv[1], "stop") == 0){
+    stop();
+    exit(0);
+  }
+  if(prof(PROF_START, 0, 0) < 0){
+    fprintf(2, "prof: start failed\n");
+    exit(1);
+  }
+  if(strcmp(argv[1], "start") == 0)
+    exit(0);
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  stop();
+  exit(0);
+}
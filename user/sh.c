@@ -3,6 +3,7 @@
 #include "kernel/fcntl.h"    // 包含文件控制头文件
 #include "kernel/stat.h"
 #include "kernel/fs.h"
+#include "user/stdio.h"
 
 // 命令类型定义
 #define EXEC  1    // 执行命令
@@ -137,6 +138,7 @@ void runcmd(struct cmd *cmd)
 }
 
 int script_fd=-1;
+FILE *cmdin;                            // stream commands are read from
 int is_valid_identifier_char(char c) { // used in tab completion
   return  (c >= 'A' && c <= 'Z') ||
           (c >= 'a' && c <= 'z') ||
@@ -220,17 +222,10 @@ int getcmd(char *buf, int nbuf)
   memset(buf, 0, nbuf);                 // 清空缓冲区
   // gets(buf, nbuf);                      // 获取用户输入
 
-  int i, cc;
-  char c;
+  int i, c;
 
   for(i=0;i<nbuf-1;){
-    if(script_fd==-1){
-      cc = read(0, &c, 1);
-    }else{
-      cc = read(script_fd, &c, 1);
-    }
-
-    if(cc<1) break;
+    if((c = fgetc(cmdin)) == EOF) break;
 
     if(c=='\t'){
       // i+= tab_completion(buf);
@@ -269,6 +264,7 @@ int main(int argc, char **argv)
 {
   static char buf[100];                 // 命令缓冲区
   int fd;                               // 文件描述符
+  struct stat st;
   
   if(argc >= 2) { // miigon: added support for running script from a file
     script_fd = open(argv[1], O_RDONLY);
@@ -286,6 +282,20 @@ int main(int argc, char **argv)
     }
   }
 
+  // A script file is read a buffer at a time; no command reads it.
+  // stdin is read a byte at a time, leaving everything past the
+  // current line to the commands, unless it is the console, whose
+  // reads never return more than one line anyway.
+  if(script_fd >= 0){
+    if((cmdin = fdopen(script_fd, "r")) == 0){
+      fprintf(2, "cannot read %s\n", argv[1]);
+      exit(1);
+    }
+  } else {
+    cmdin = stdin;
+    if(fstat(0, &st) < 0 || st.type != T_DEVICE)
+      setvbuf(stdin, 0, _IONBF, 0);
+  }
   
 
   while(getcmd(buf, sizeof(buf)) >= 0){  // 获取命令输入
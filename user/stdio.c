@@ -0,0 +1,376 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/stdio.h"
+
+// Buffered streams on top of read() and write().
+//
+// An output stream collects bytes in its buffer and writes
+// them with one write() when the buffer fills, at a newline
+// (line buffering), or at the end of each call (no buffering).
+// An input stream reads a whole buffer at a time and hands
+// it out piecemeal; an unbuffered input stream reads one byte
+// at a time, so it never consumes input meant for a child.
+//
+// Unless setvbuf() says otherwise, a stream is line buffered
+// if it refers to a device such as the console, and fully
+// buffered otherwise. stderr is unbuffered.
+//
+// Buffered output is written out by exit(), and before fork()
+// and exec(), through the stdioflush hook in ulib.c.
+
+#define F_READ    0x1   // open for reading
+#define F_WRITE   0x2   // open for writing
+#define F_EOF     0x4   // a read hit end of file
+#define F_ERR     0x8   // a read or write failed
+#define F_MALLOC  0x10  // buf came from malloc()
+#define F_MODESET 0x20  // mode has been chosen
+
+static char inbuf[BUFSIZ], outbuf[BUFSIZ], errbuf[BUFSIZ];
+
+// a slot with flags == 0 is free.
+static FILE files[FOPEN_MAX] = {
+  { 0, F_READ, _IOFBF, inbuf, BUFSIZ, 0, 0 },
+  { 1, F_WRITE, _IOFBF, outbuf, BUFSIZ, 0, 0 },
+  { 2, F_WRITE|F_MODESET, _IONBF, errbuf, BUFSIZ, 0, 0 },
+};
+
+FILE *stdin = &files[0];
+FILE *stdout = &files[1];
+FILE *stderr = &files[2];
+
+// Choose fp's buffering mode the first time it is used.
+static void
+setmode(FILE *fp)
+{
+  struct stat st;
+
+  if(fp->flags & F_MODESET)
+    return;
+  fp->flags |= F_MODESET;
+  if(fstat(fp->fd, &st) == 0 && st.type == T_DEVICE)
+    fp->mode = _IOLBF;
+  else
+    fp->mode = _IOFBF;
+}
+
+static void
+flushall(void)
+{
+  FILE *fp;
+
+  for(fp = files; fp < files + FOPEN_MAX; fp++){
+    if((fp->flags & F_WRITE) && fp->pos > 0)
+      fflush(fp);
+  }
+}
+
+// Write out fp's buffered output.
+// fflush(0) flushes every stream.
+int
+fflush(FILE *fp)
+{
+  int n, off;
+
+  if(fp == 0){
+    flushall();
+    return 0;
+  }
+  if((fp->flags & F_WRITE) == 0)
+    return 0;
+  for(off = 0; off < fp->pos; off += n){
+    if((n = write(fp->fd, fp->buf + off, fp->pos - off)) <= 0){
+      fp->flags |= F_ERR;
+      fp->pos = 0;
+      return EOF;
+    }
+  }
+  fp->pos = 0;
+  return 0;
+}
+
+// Append n bytes from s to fp's buffer, writing the buffer
+// out as it fills. A write at least as large as the buffer
+// goes straight to the file if nothing is buffered.
+// Returns the number of bytes accepted.
+static int
+put(FILE *fp, const char *s, int n)
+{
+  int i, m, tot;
+
+  if((fp->flags & F_WRITE) == 0){
+    fp->flags |= F_ERR;
+    return 0;
+  }
+  setmode(fp);
+  stdioflush = flushall;
+
+  if(fp->pos == 0 && n >= fp->size){
+    for(tot = 0; tot < n; tot += m){
+      if((m = write(fp->fd, s + tot, n - tot)) <= 0){
+        fp->flags |= F_ERR;
+        break;
+      }
+    }
+    return tot;
+  }
+
+  for(tot = 0; tot < n; tot += m){
+    if(fp->pos == fp->size && fflush(fp) < 0)
+      return tot;
+    m = n - tot;
+    if(m > fp->size - fp->pos)
+      m = fp->size - fp->pos;
+    memmove(fp->buf + fp->pos, s + tot, m);
+    fp->pos += m;
+  }
+
+  if(fp->mode == _IONBF){
+    fflush(fp);
+  } else if(fp->mode == _IOLBF){
+    for(i = 0; i < n; i++){
+      if(s[i] == '\n'){
+        fflush(fp);
+        break;
+      }
+    }
+  }
+  return tot;
+}
+
+// Refill fp's buffer.
+// Returns the number of bytes now buffered,
+// or 0 at end of file or on error.
+static int
+fill(FILE *fp)
+{
+  int n;
+
+  fp->pos = fp->len = 0;
+  if((fp->flags & F_READ) == 0){
+    fp->flags |= F_ERR;
+    return 0;
+  }
+  setmode(fp);
+  // let a prompt show before we wait for the answer.
+  if(fp == stdin)
+    fflush(stdout);
+  n = read(fp->fd, fp->buf, fp->mode == _IONBF ? 1 : fp->size);
+  if(n <= 0){
+    fp->flags |= (n == 0 ? F_EOF : F_ERR);
+    return 0;
+  }
+  fp->flags &= ~F_EOF;
+  fp->len = n;
+  return n;
+}
+
+FILE*
+fdopen(int fd, const char *mode)
+{
+  FILE *fp;
+  int flags;
+
+  if(mode[0] == 'r')
+    flags = F_READ;
+  else if(mode[0] == 'w')
+    flags = F_WRITE;
+  else
+    return 0;
+
+  for(fp = files; fp < files + FOPEN_MAX; fp++){
+    if(fp->flags == 0)
+      break;
+  }
+  if(fp == files + FOPEN_MAX)
+    return 0;
+  if((fp->buf = malloc(BUFSIZ)) == 0)
+    return 0;
+  fp->fd = fd;
+  fp->flags = flags | F_MALLOC;
+  fp->mode = _IOFBF;
+  fp->size = BUFSIZ;
+  fp->pos = fp->len = 0;
+  return fp;
+}
+
+// Open a file for reading ("r") or writing ("w").
+// Opening for writing creates or truncates the file.
+FILE*
+fopen(const char *path, const char *mode)
+{
+  FILE *fp;
+  int fd;
+
+  if(mode[0] == 'r')
+    fd = open(path, O_RDONLY);
+  else if(mode[0] == 'w')
+    fd = open(path, O_WRONLY|O_CREATE|O_TRUNC);
+  else
+    return 0;
+  if(fd < 0)
+    return 0;
+  if((fp = fdopen(fd, mode)) == 0)
+    close(fd);
+  return fp;
+}
+
+int
+fclose(FILE *fp)
+{
+  int r;
+
+  r = fflush(fp);
+  if(close(fp->fd) < 0)
+    r = EOF;
+  if(fp->flags & F_MALLOC)
+    free(fp->buf);
+  fp->flags = 0;
+  return r;
+}
+
+// Set fp's buffering mode, and optionally supply a buffer
+// of size bytes. Must come before any I/O on fp.
+int
+setvbuf(FILE *fp, char *buf, int mode, int size)
+{
+  if(fp->pos != 0 || fp->len != 0)
+    return EOF;
+  if(mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return EOF;
+  if(buf != 0){
+    if(size < 1)
+      return EOF;
+    if(fp->flags & F_MALLOC)
+      free(fp->buf);
+    fp->flags &= ~F_MALLOC;
+    fp->buf = buf;
+    fp->size = size;
+  }
+  fp->mode = mode;
+  fp->flags |= F_MODESET;
+  return 0;
+}
+
+int
+fread(void *dst, int size, int nmemb, FILE *fp)
+{
+  char *d = dst;
+  int n, m, tot;
+
+  n = size * nmemb;
+  if(size <= 0 || n <= 0)
+    return 0;
+  for(tot = 0; tot < n; tot += m){
+    if(fp->pos == fp->len){
+      // a large read goes straight into the caller's memory.
+      if(n - tot >= fp->size && (fp->flags & F_READ)){
+        if(fp == stdin)
+          fflush(stdout);
+        if((m = read(fp->fd, d + tot, n - tot)) <= 0){
+          fp->flags |= (m == 0 ? F_EOF : F_ERR);
+          break;
+        }
+        continue;
+      }
+      if(fill(fp) == 0)
+        break;
+    }
+    m = n - tot;
+    if(m > fp->len - fp->pos)
+      m = fp->len - fp->pos;
+    memmove(d + tot, fp->buf + fp->pos, m);
+    fp->pos += m;
+  }
+  return tot / size;
+}
+
+int
+fwrite(const void *src, int size, int nmemb, FILE *fp)
+{
+  int n;
+
+  n = size * nmemb;
+  if(size <= 0 || n <= 0)
+    return 0;
+  return put(fp, src, n) / size;
+}
+
+int
+fgetc(FILE *fp)
+{
+  if(fp->pos == fp->len && fill(fp) == 0)
+    return EOF;
+  return (uchar)fp->buf[fp->pos++];
+}
+
+int
+fputc(int c, FILE *fp)
+{
+  char ch = c;
+
+  if(put(fp, &ch, 1) != 1)
+    return EOF;
+  return (uchar)ch;
+}
+
+// Read a line of at most n-1 bytes, including the newline.
+// Returns 0 if nothing could be read.
+char*
+fgets(char *buf, int n, FILE *fp)
+{
+  int i, c;
+
+  for(i = 0; i+1 < n; ){
+    if((c = fgetc(fp)) == EOF)
+      break;
+    buf[i++] = c;
+    if(c == '\n')
+      break;
+  }
+  if(i == 0 && n > 1)
+    return 0;
+  if(n > 0)
+    buf[i] = '\0';
+  return buf;
+}
+
+int
+fputs(const char *s, FILE *fp)
+{
+  int n;
+
+  n = strlen(s);
+  if(put(fp, s, n) != n)
+    return EOF;
+  return n;
+}
+
+int
+feof(FILE *fp)
+{
+  return (fp->flags & F_EOF) != 0;
+}
+
+int
+ferror(FILE *fp)
+{
+  return (fp->flags & F_ERR) != 0;
+}
+
+char*
+gets(char *buf, int max)
+{
+  int i, c;
+
+  for(i=0; i+1 < max; ){
+    if((c = fgetc(stdin)) == EOF)
+      break;
+    buf[i++] = c;
+    if(c == '\n' || c == '\r')
+      break;
+  }
+  buf[i] = '\0';
+  return buf;
+}
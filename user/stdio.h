@@ -0,0 +1,38 @@
+// Buffered I/O streams for user programs.
+// Include after user/user.h.
+
+#define BUFSIZ    512   // size of a stream's buffer
+#define FOPEN_MAX  16   // maximum open streams, including std ones
+#define EOF       (-1)
+
+// Buffering modes, for setvbuf().
+#define _IOFBF  0   // write when the buffer fills
+#define _IOLBF  1   // also write at each newline
+#define _IONBF  2   // write at the end of each call
+
+typedef struct {
+  int fd;       // underlying file descriptor
+  int flags;    // F_* in stdio.c; 0 if the slot is free
+  int mode;     // _IOFBF, _IOLBF or _IONBF
+  char *buf;
+  int size;     // capacity of buf
+  int pos;      // next byte of buf to read or write
+  int len;      // number of valid bytes in buf, when reading
+} FILE;
+
+extern FILE *stdin, *stdout, *stderr;
+
+// stdio.c
+FILE* fopen(const char*, const char*);
+FILE* fdopen(int, const char*);
+int fclose(FILE*);
+int fflush(FILE*);
+int setvbuf(FILE*, char*, int, int);
+int fread(void*, int, int, FILE*);
+int fwrite(const void*, int, int, FILE*);
+int fgetc(FILE*);
+int fputc(int, FILE*);
+char* fgets(char*, int, FILE*);
+int fputs(const char*, FILE*);
+int feof(FILE*);
+int ferror(FILE*);
@@ -0,0 +1,48 @@
+// Run a command and report the time and resources it used.
+//
+// usage: time cmd [arg ...]
+//
+// Times are in timer ticks, as returned by uptime().
+
+#include "kernel/types.h"
+#include "kernel/rusage.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct rusage r0, r;
+  int pid, t0, status;
+
+  if(argc < 2){
+    fprintf(2, "usage: time cmd [arg ...]\n");
+    exit(1);
+  }
+
+  getrusage(RUSAGE_CHILDREN, &r0);
+  t0 = uptime();
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "time: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "time: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(&status);
+  if(getrusage(RUSAGE_CHILDREN, &r) < 0){
+    fprintf(2, "time: getrusage failed\n");
+    exit(1);
+  }
+
+  fprintf(2, "%d real, %l user, %l sys ticks\n", uptime() - t0,
+          r.utime - r0.utime, r.stime - r0.stime);
+  fprintf(2, "%l voluntary, %l involuntary switches, %l faults\n",
+          r.nvcsw - r0.nvcsw, r.nivcsw - r0.nivcsw, r.nfault - r0.nfault);
+  fprintf(2, "%l blocks in, %l blocks out, %l bytes piped, %l syscalls\n",
+          r.inblock - r0.inblock, r.oublock - r0.oublock,
+          r.piped - r0.piped, r.nsyscall - r0.nsyscall);
+  exit(status);
+}
@@ -0,0 +1,107 @@
+// Measure the cost of a trip into the kernel and of a
+// switch between processes, in cycles.
+//
+// usage: trapbench [rounds]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+static inline uint64
+rdcycle(void)
+{
+  uint64 x;
+  asm volatile("rdcycle %0" : "=r" (x));
+  return x;
+}
+
+static void
+report(char *name, int ops, uint64 c0)
+{
+  uint64 c = rdcycle() - c0;
+
+  printf("%s: %d ops, %l cycles/op\n", name, ops, c / ops);
+}
+
+// a system call that does nothing but return.
+static void
+nullsys(int rounds)
+{
+  int i;
+  uint64 c0;
+
+  c0 = rdcycle();
+  for(i = 0; i < rounds; i++)
+    _getpid();
+  report("null syscall", rounds, c0);
+}
+
+// getpid() through the page the kernel maps for it.
+static void
+nosys(int rounds)
+{
+  int i;
+  uint64 c0;
+
+  c0 = rdcycle();
+  for(i = 0; i < rounds; i++)
+    getpid();
+  report("getpid page", rounds, c0);
+}
+
+// bounce a byte between two processes over a pair of
+// pipes; each round trip is two context switches.
+static void
+ctxsw(int rounds)
+{
+  int i, pid, p1[2], p2[2];
+  char c;
+  uint64 c0;
+
+  if(pipe(p1) < 0 || pipe(p2) < 0){
+    fprintf(2, "trapbench: pipe failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "trapbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p1[1]);
+    close(p2[0]);
+    while(read(p1[0], &c, 1) == 1)
+      write(p2[1], &c, 1);
+    exit(0);
+  }
+  close(p1[0]);
+  close(p2[1]);
+
+  c0 = rdcycle();
+  for(i = 0; i < rounds; i++){
+    if(write(p1[1], "x", 1) != 1 || read(p2[0], &c, 1) != 1){
+      fprintf(2, "trapbench: pipe i/o failed\n");
+      exit(1);
+    }
+  }
+  report("switch", 2*rounds, c0);
+
+  close(p1[1]);
+  close(p2[0]);
+  wait(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 100000;
+
+  if(argc > 1 && (rounds = atoi(argv[1])) <= 0){
+    fprintf(2, "usage: trapbench [rounds]\n");
+    exit(1);
+  }
+
+  nullsys(rounds);
+  nosys(rounds);
+  ctxsw(rounds < 10 ? 1 : rounds / 10);
+  exit(0);
+}
@@ -2,6 +2,8 @@
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
 #include "user/user.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
 
 char*
 strcpy(char *s, const char *t)
@@ -32,14 +34,36 @@ strlen(const char *s)
   return n;
 }
 
+// memset, memmove and memcmp work a 64-bit word at a time
+// when the pointers share alignment, as in kernel/string.c.
+#define WORDMASK (sizeof(uint64) - 1)
+
 void*
 memset(void *dst, int c, uint n)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uchar *d = dst;
+  uint64 w, *wd;
+
+  while(n > 0 && ((uint64)d & WORDMASK)){
+    *d++ = c;
+    n--;
+  }
+  w = (uchar)c;
+  w |= w << 8;
+  w |= w << 16;
+  w |= w << 32;
+  wd = (uint64*)d;
+  for(; n >= 4*sizeof(uint64); n -= 4*sizeof(uint64), wd += 4){
+    wd[0] = w;
+    wd[1] = w;
+    wd[2] = w;
+    wd[3] = w;
   }
+  for(; n >= sizeof(uint64); n -= sizeof(uint64))
+    *wd++ = w;
+  d = (uchar*)wd;
+  while(n-- > 0)
+    *d++ = c;
   return dst;
 }
 
@@ -52,24 +76,6 @@ strchr(const char *s, char c)
   return 0;
 }
 
-char*
-gets(char *buf, int max)
-{
-  int i, cc;
-  char c;
-
-  for(i=0; i+1 < max; ){
-    cc = read(0, &c, 1);
-    if(cc < 1)
-      break;
-    buf[i++] = c;
-    if(c == '\n' || c == '\r')
-      break;
-  }
-  buf[i] = '\0';
-  return buf;
-}
-
 int
 stat(const char *n, struct stat *st)
 {
@@ -101,15 +107,56 @@ memmove(void *vdst, const void *vsrc, int n)
 {
   char *dst;
   const char *src;
+  uint64 *wd;
+  const uint64 *ws;
+  int aligned;
 
   dst = vdst;
   src = vsrc;
+  aligned = (((uint64)src ^ (uint64)dst) & WORDMASK) == 0;
   if (src > dst) {
+    if(aligned){
+      while(n > 0 && ((uint64)dst & WORDMASK)){
+        *dst++ = *src++;
+        n--;
+      }
+      wd = (uint64*)dst;
+      ws = (const uint64*)src;
+      for(; n >= 4*(int)sizeof(uint64); n -= 4*sizeof(uint64), wd += 4, ws += 4){
+        wd[0] = ws[0];
+        wd[1] = ws[1];
+        wd[2] = ws[2];
+        wd[3] = ws[3];
+      }
+      for(; n >= (int)sizeof(uint64); n -= sizeof(uint64))
+        *wd++ = *ws++;
+      dst = (char*)wd;
+      src = (const char*)ws;
+    }
     while(n-- > 0)
       *dst++ = *src++;
   } else {
     dst += n;
     src += n;
+    if(aligned){
+      while(n > 0 && ((uint64)dst & WORDMASK)){
+        *--dst = *--src;
+        n--;
+      }
+      wd = (uint64*)dst;
+      ws = (const uint64*)src;
+      for(; n >= 4*(int)sizeof(uint64); n -= 4*sizeof(uint64)){
+        wd -= 4, ws -= 4;
+        wd[3] = ws[3];
+        wd[2] = ws[2];
+        wd[1] = ws[1];
+        wd[0] = ws[0];
+      }
+      for(; n >= (int)sizeof(uint64); n -= sizeof(uint64))
+        *--wd = *--ws;
+      dst = (char*)wd;
+      src = (const char*)ws;
+    }
     while(n-- > 0)
       *--dst = *--src;
   }
@@ -120,6 +167,23 @@ int
 memcmp(const void *s1, const void *s2, uint n)
 {
   const char *p1 = s1, *p2 = s2;
+  const uint64 *w1, *w2;
+
+  if((((uint64)p1 ^ (uint64)p2) & WORDMASK) == 0){
+    while(n > 0 && ((uint64)p1 & WORDMASK)){
+      if(*p1 != *p2)
+        return *p1 - *p2;
+      p1++, p2++, n--;
+    }
+    w1 = (const uint64*)p1;
+    w2 = (const uint64*)p2;
+    while(n >= sizeof(uint64) && *w1 == *w2){
+      w1++, w2++;
+      n -= sizeof(uint64);
+    }
+    p1 = (const char*)w1;
+    p2 = (const char*)w2;
+  }
   while (n-- > 0) {
     if (*p1 != *p2) {
       return *p1 - *p2;
@@ -135,3 +199,47 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// Set by stdio.c once a stream holds buffered output, so
+// that it is written out before the process exits, and
+// neither duplicated by fork() nor lost by exec().
+void (*stdioflush)(void);
+
+int
+fork(void)
+{
+  if(stdioflush)
+    stdioflush();
+  return _fork();
+}
+
+int
+exit(int status)
+{
+  if(stdioflush)
+    stdioflush();
+  _exit(status);
+}
+
+int
+exec(char *path, char **argv)
+{
+  if(stdioflush)
+    stdioflush();
+  return _exec(path, argv);
+}
+
+// The kernel keeps these values in read-only pages
+// mapped into every process, so reading them takes
+// a load rather than a system call.
+int
+getpid(void)
+{
+  return ((struct usyscall*)USYSCALL)->pid;
+}
+
+int
+uptime(void)
+{
+  return ((volatile struct ushared*)USHARED)->ticks;
+}
@@ -3,8 +3,24 @@
 #include "user/user.h"
 #include "kernel/param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with size classes.
+//
+// Small requests are rounded up, header included, to a
+// power-of-two size class between 32 and 2048 bytes and
+// served from a free list per class. An empty list is refilled
+// by carving a slab of heap into equal blocks. malloc() and
+// free() of a small block take constant time.
+//
+// Larger requests, and the slabs themselves, come from an
+// address-ordered list of free large blocks, searched first-fit
+// and coalesced on free, as in Kernighan and Ritchie, The C
+// Programming Language, 2nd ed.  Section 8.7. A big enough free
+// block at the top of the heap is handed back to the kernel
+// with a negative sbrk().
+//
+// Every block starts with a Header holding its size in Header
+// units; a size of at most SMALLMAX/sizeof(Header) marks a
+// small block.
 
 typedef long Align;
 
@@ -18,15 +34,60 @@ union header {
 
 typedef union header Header;
 
+#define SMALLMIN   32     // smallest size class (bytes, with header)
+#define SMALLMAX   2048   // largest size class
+#define NCLASS     7      // 32, 64, ..., 2048
+#define SLABUNITS  1024   // Headers per slab (16 KB)
+#define MOREUNITS  1024   // least Headers to ask sbrk() for
+#define TRIMUNITS  4096   // free Headers at the top worth returning
+
+static Header *smallfree[NCLASS];
+
 static Header base;
 static Header *freep;
 
-void
-free(void *ap)
+static struct mstats stats;
+
+// Index of the smallest size class holding n bytes.
+static int
+sizeclass(uint n)
 {
-  Header *bp, *p;
+  int c;
+  uint sz;
+
+  for(c = 0, sz = SMALLMIN; sz < n; c++, sz <<= 1)
+    ;
+  return c;
+}
+
+// Is the free large block p big enough to give back,
+// and at the top of the heap?
+static int
+attop(Header *p)
+{
+  return p->s.size >= TRIMUNITS && (char*)(p + p->s.size) == sbrk(0);
+}
+
+// Give the free large block p, whose predecessor on
+// the free list is prevp, back to the kernel.
+static void
+trim(Header *prevp, Header *p)
+{
+  prevp->s.ptr = p->s.ptr;
+  freep = prevp;
+  stats.heap -= p->s.size * sizeof(Header);
+  stats.released += p->s.size * sizeof(Header);
+  sbrk(-(int)(p->s.size * sizeof(Header)));
+}
+
+// Put bp on the large free list, merging it with its
+// neighbours. Returns the block before bp on the list,
+// which has absorbed bp if they were adjacent.
+static Header*
+insert(Header *bp)
+{
+  Header *p;
 
-  bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -41,6 +102,24 @@ free(void *ap)
   } else
     p->s.ptr = bp;
   freep = p;
+  return p;
+}
+
+static void
+freelarge(Header *bp)
+{
+  Header *p, *prevp;
+
+  p = insert(bp);
+  if(p->s.ptr == bp){
+    if(attop(bp))
+      trim(p, bp);
+  } else if(attop(p)){
+    // bp merged into p; find p's predecessor.
+    for(prevp = p; prevp->s.ptr != p; prevp = prevp->s.ptr)
+      ;
+    trim(prevp, p);
+  }
 }
 
 static Header*
@@ -49,24 +128,25 @@ morecore(uint nu)
   char *p;
   Header *hp;
 
-  if(nu < 4096)
-    nu = 4096;
+  if(nu < MOREUNITS)
+    nu = MOREUNITS;
   p = sbrk(nu * sizeof(Header));
   if(p == (char*)-1)
     return 0;
+  stats.heap += nu * sizeof(Header);
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  insert(hp);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+// Allocate a block of nunits Headers, header included,
+// from the large free list.
+static Header*
+alloclarge(uint nunits)
 {
   Header *p, *prevp;
-  uint nunits;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
@@ -81,10 +161,119 @@ malloc(uint nbytes)
         p->s.size = nunits;
       }
       freep = prevp;
-      return (void*)(p + 1);
+      return p;
     }
     if(p == freep)
       if((p = morecore(nunits)) == 0)
         return 0;
   }
 }
+
+// Refill the free list of class c from a new slab.
+static int
+moresmall(int c)
+{
+  Header *slab, *h;
+  uint units, i, n;
+
+  if((slab = alloclarge(SLABUNITS)) == 0)
+    return 0;
+  units = (SMALLMIN << c) / sizeof(Header);
+  n = (SLABUNITS - 1) / units;
+  for(i = 0; i < n; i++){
+    h = slab + 1 + i*units;
+    h->s.size = units;
+    h->s.ptr = smallfree[c];
+    smallfree[c] = h;
+  }
+  return 1;
+}
+
+void
+free(void *ap)
+{
+  Header *bp;
+  int c;
+
+  if(ap == 0)
+    return;
+  bp = (Header*)ap - 1;
+  stats.nfree++;
+  stats.inuse -= bp->s.size * sizeof(Header);
+  if(bp->s.size <= SMALLMAX / sizeof(Header)){
+    c = sizeclass(bp->s.size * sizeof(Header));
+    bp->s.ptr = smallfree[c];
+    smallfree[c] = bp;
+    return;
+  }
+  freelarge(bp);
+}
+
+void*
+malloc(uint nbytes)
+{
+  Header *p;
+  int c;
+
+  if(nbytes + sizeof(Header) <= SMALLMAX){
+    c = sizeclass(nbytes + sizeof(Header));
+    if(smallfree[c] == 0 && !moresmall(c))
+      return 0;
+    p = smallfree[c];
+    smallfree[c] = p->s.ptr;
+  } else {
+    if(nbytes > 0x7fffffff)
+      return 0;
+    p = alloclarge((nbytes + sizeof(Header) - 1)/sizeof(Header) + 1);
+    if(p == 0)
+      return 0;
+  }
+  stats.nmalloc++;
+  stats.inuse += p->s.size * sizeof(Header);
+  return (void*)(p + 1);
+}
+
+void*
+calloc(uint nmemb, uint size)
+{
+  void *p;
+  uint64 n;
+
+  n = (uint64)nmemb * size;
+  if(n > 0x7fffffff)
+    return 0;
+  if((p = malloc(n)) != 0)
+    memset(p, 0, n);
+  return p;
+}
+
+void*
+realloc(void *ap, uint nbytes)
+{
+  Header *bp;
+  uint have;
+  void *p;
+
+  if(ap == 0)
+    return malloc(nbytes);
+  if(nbytes == 0){
+    free(ap);
+    return 0;
+  }
+  bp = (Header*)ap - 1;
+  have = (bp->s.size - 1) * sizeof(Header);
+  if(nbytes <= have)
+    return ap;
+  if((p = malloc(nbytes)) == 0)
+    return 0;
+  memmove(p, ap, have);
+  free(ap);
+  return p;
+}
+
+// Copy out the allocator's counters.
+void
+mstat(struct mstats *st)
+{
+  *st = stats;
+}
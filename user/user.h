@@ -1,5 +1,13 @@
 struct stat;
 struct rtcdate;
+struct iovec;
+struct mstats;
+struct ring;
+struct lockinfo;
+struct sample;
+struct trec;
+struct rusage;
+struct diskstat;
 
 // system calls
 int fork(void);
@@ -23,8 +31,31 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int splice(int, int, int);
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+int ringenter(struct ring*);
+int lockstat(struct lockinfo*, int, int);
+int prof(int, struct sample*, int);
+int ktrace(int, struct trec*, int);
+int getrusage(int, struct rusage*);
+int dmesg(char*, int);
+int ioctl(int, int, uint64);
+int diskstat(struct diskstat*);
+int fsync(int);
+int sync(void);
+
+// usys.S entries wrapped by ulib.c
+int _fork(void);
+int _exit(int) __attribute__((noreturn));
+int _exec(char*, char**);
+int _getpid(void);
+int _uptime(void);
 
 // ulib.c
+extern void (*stdioflush)(void);
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
 void *memmove(void*, const void*, int);
@@ -37,6 +68,18 @@ uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
+void* calloc(uint, uint);
+void* realloc(void*, uint);
+void mstat(struct mstats*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+
+// umalloc.c counters, from mstat()
+struct mstats {
+  uint64 nmalloc;   // successful malloc() calls
+  uint64 nfree;     // free() calls
+  uint64 inuse;     // bytes in allocated blocks, with headers
+  uint64 heap;      // bytes got from sbrk() and not given back
+  uint64 released;  // bytes given back with a negative sbrk()
+};
@@ -2,8 +2,16 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "user/user.h"
+#include "user/stdio.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
+#include "kernel/uio.h"
+#include "kernel/ring.h"
+#include "kernel/lockstat.h"
+#include "kernel/prof.h"
+#include "kernel/trace.h"
+#include "kernel/rusage.h"
+#include "kernel/diskstat.h"
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
@@ -735,6 +743,816 @@ pipe1(char *s)
   }
 }
 
+// splice data from a file into a pipe and from a pipe
+// back into a file, without going through user memory.
+void
+splicetest(char *s)
+{
+  int fd, fds[2], pid, xstatus, i, n, total;
+  enum { SZ=3000 };
+
+  unlink("splicef");
+  fd = open("splicef", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create splicef failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++)
+    buf[i] = i;
+  if(write(fd, buf, SZ) != SZ){
+    printf("%s: write splicef failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork() failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    fd = open("splicef", O_RDONLY);
+    total = 0;
+    while((n = splice(fd, fds[1], SZ)) > 0)
+      total += n;
+    if(n < 0 || total != SZ){
+      printf("%s: splice file to pipe moved %d\n", s, total);
+      exit(1);
+    }
+    exit(0);
+  }
+
+  close(fds[1]);
+  fd = open("splicef2", O_CREATE|O_RDWR);
+  total = 0;
+  while((n = splice(fds[0], fd, 1024)) > 0)
+    total += n;
+  close(fds[0]);
+  close(fd);
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+  if(total != SZ){
+    printf("%s: splice pipe to file moved %d\n", s, total);
+    exit(1);
+  }
+
+  memset(buf, 0, SZ);
+  fd = open("splicef2", O_RDONLY);
+  if(read(fd, buf, sizeof(buf)) != SZ){
+    printf("%s: splicef2 wrong size\n", s);
+    exit(1);
+  }
+  close(fd);
+  for(i = 0; i < SZ; i++){
+    if((buf[i] & 0xff) != (i & 0xff)){
+      printf("%s: splicef2 wrong content\n", s);
+      exit(1);
+    }
+  }
+  unlink("splicef");
+  unlink("splicef2");
+}
+
+// readv/writev gather and scatter; pread/pwrite use
+// explicit offsets and leave the file offset alone.
+void
+iovtest(char *s)
+{
+  int fd, i;
+  char a[10], b[2000], c[7], x[4];
+  struct iovec iov[3];
+
+  memset(a, 'a', sizeof(a));
+  memset(b, 'b', sizeof(b));
+  memset(c, 'c', sizeof(c));
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof(b);
+  iov[2].iov_base = c;
+  iov[2].iov_len = sizeof(c);
+
+  unlink("iovf");
+  fd = open("iovf", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create iovf failed\n", s);
+    exit(1);
+  }
+  if(writev(fd, iov, 3) != sizeof(a)+sizeof(b)+sizeof(c)){
+    printf("%s: writev failed\n", s);
+    exit(1);
+  }
+
+  // overwrite the start of c without moving the offset.
+  if(pwrite(fd, "xyz", 3, sizeof(a)+sizeof(b)) != 3){
+    printf("%s: pwrite failed\n", s);
+    exit(1);
+  }
+  if(pread(fd, x, 4, sizeof(a)+sizeof(b)-1) != 4 || memcmp(x, "bxyz", 4) != 0){
+    printf("%s: pread wrong data\n", s);
+    exit(1);
+  }
+  if(write(fd, "!", 1) != 1){
+    printf("%s: write after pwrite failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  memset(a, 0, sizeof(a));
+  memset(b, 0, sizeof(b));
+  memset(c, 0, sizeof(c));
+  fd = open("iovf", O_RDONLY);
+  if(readv(fd, iov, 3) != sizeof(a)+sizeof(b)+sizeof(c)){
+    printf("%s: readv short\n", s);
+    exit(1);
+  }
+  for(i = 0; i < sizeof(a); i++)
+    if(a[i] != 'a')
+      exit(1);
+  for(i = 0; i < sizeof(b); i++)
+    if(b[i] != 'b')
+      exit(1);
+  if(memcmp(c, "xyzcccc", sizeof(c)) != 0){
+    printf("%s: readv wrong data\n", s);
+    exit(1);
+  }
+  if(read(fd, x, sizeof(x)) != 1 || x[0] != '!'){
+    printf("%s: file offset wrong after readv\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("iovf");
+}
+
+// buffered streams: many small writes and line reads
+// through fputs/fgets, and a bulk fread.
+void
+stdiotest(char *s)
+{
+  FILE *fp;
+  int i, n;
+  char line[32];
+
+  unlink("stdiof");
+  if((fp = fopen("stdiof", "w")) == 0){
+    printf("%s: fopen w failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 200; i++){
+    if(fputs("line of text\n", fp) < 0){
+      printf("%s: fputs failed\n", s);
+      exit(1);
+    }
+  }
+  if(fclose(fp) != 0){
+    printf("%s: fclose failed\n", s);
+    exit(1);
+  }
+
+  if((fp = fopen("stdiof", "r")) == 0){
+    printf("%s: fopen r failed\n", s);
+    exit(1);
+  }
+  for(i = 0; fgets(line, sizeof(line), fp) != 0; i++){
+    if(strcmp(line, "line of text\n") != 0){
+      printf("%s: fgets got %s\n", s, line);
+      exit(1);
+    }
+  }
+  if(i != 200 || !feof(fp)){
+    printf("%s: fgets read %d lines\n", s, i);
+    exit(1);
+  }
+  fclose(fp);
+
+  fp = fopen("stdiof", "r");
+  n = fread(buf, 1, sizeof(buf), fp);
+  fclose(fp);
+  if(n != 200 * 13){
+    printf("%s: fread read %d\n", s, n);
+    exit(1);
+  }
+  unlink("stdiof");
+}
+
+// queue a batch of file operations with ringenter().
+void
+ringtest(char *s)
+{
+  static struct ring r;
+  struct sqe *e;
+  struct stat st;
+  char x[8];
+  int i, n;
+
+  unlink("ringf");
+  memset(&r, 0, sizeof(r));
+  memset(x, 0, sizeof(x));
+
+  // open, write, pwrite, fstat, pread, close: fd 3 is
+  // assumed to be the lowest free descriptor.
+  e = &r.sq[r.sqtail++ % RING_SIZE];
+  e->op = RING_OPEN;
+  e->addr = (uint64)"ringf";
+  e->len = O_CREATE|O_RDWR;
+  e->data = 0;
+  e = &r.sq[r.sqtail++ % RING_SIZE];
+  e->op = RING_WRITE;
+  e->fd = 3;
+  e->addr = (uint64)"abcdef";
+  e->len = 6;
+  e->off = -1;
+  e->data = 1;
+  e = &r.sq[r.sqtail++ % RING_SIZE];
+  e->op = RING_WRITE;
+  e->fd = 3;
+  e->addr = (uint64)"XY";
+  e->len = 2;
+  e->off = 1;
+  e->data = 2;
+  e = &r.sq[r.sqtail++ % RING_SIZE];
+  e->op = RING_FSTAT;
+  e->fd = 3;
+  e->addr = (uint64)&st;
+  e->data = 3;
+  e = &r.sq[r.sqtail++ % RING_SIZE];
+  e->op = RING_READ;
+  e->fd = 3;
+  e->addr = (uint64)x;
+  e->len = 4;
+  e->off = 0;
+  e->data = 4;
+  e = &r.sq[r.sqtail++ % RING_SIZE];
+  e->op = RING_CLOSE;
+  e->fd = 3;
+  e->data = 5;
+  e = &r.sq[r.sqtail++ % RING_SIZE];
+  e->op = 99;
+  e->data = 6;
+
+  if((n = ringenter(&r)) != 7 || r.sqhead != 7 || r.cqtail != 7){
+    printf("%s: ringenter returned %d\n", s, n);
+    exit(1);
+  }
+  int want[] = { 3, 6, 2, 0, 4, 0, -1 };
+  for(i = 0; i < 7; i++){
+    if(r.cq[i].data != i || r.cq[i].res != want[i]){
+      printf("%s: completion %d: data %d res %d\n", s, i, (int)r.cq[i].data, r.cq[i].res);
+      exit(1);
+    }
+  }
+  r.cqhead = r.cqtail;
+  if(st.size != 6 || memcmp(x, "aXYd", 4) != 0){
+    printf("%s: wrong size or data\n", s);
+    exit(1);
+  }
+
+  // a full completion queue stops the batch.
+  for(i = 0; i < RING_SIZE; i++){
+    e = &r.sq[r.sqtail++ % RING_SIZE];
+    e->op = RING_NOP;
+    e->data = i;
+  }
+  r.cqhead -= 1;
+  if((n = ringenter(&r)) != RING_SIZE-1 || r.sqtail - r.sqhead != 1){
+    printf("%s: ringenter ran %d with %d completion slots\n", s, n, RING_SIZE-1);
+    exit(1);
+  }
+  r.cqhead = r.cqtail;
+  if(ringenter(&r) != 1 || ringenter(&r) != 0){
+    printf("%s: ringenter did not drain\n", s);
+    exit(1);
+  }
+  if(ringenter((struct ring*)0xffffffffffff) != -1){
+    printf("%s: ringenter accepted a bad ring\n", s);
+    exit(1);
+  }
+  unlink("ringf");
+}
+
+// lockstat() reports the kernel's lock counters by name.
+void
+lockstattest(char *s)
+{
+  static struct lockinfo info[64];
+  int i, n, found;
+
+  if((n = lockstat(info, 64, 0)) <= 0){
+    printf("%s: lockstat returned %d\n", s, n);
+    exit(1);
+  }
+  found = 0;
+  for(i = 0; i < n; i++){
+    if(strcmp(info[i].name, "proc") == 0 && info[i].sleep == 0 &&
+       info[i].nacquire > 0)
+      found |= 1;
+    if(strcmp(info[i].name, "inode") == 0 && info[i].sleep == 1 &&
+       info[i].nacquire > 0)
+      found |= 2;
+    if(info[i].ncontend > info[i].nacquire){
+      printf("%s: %s contended more than acquired\n", s, info[i].name);
+      exit(1);
+    }
+  }
+  if(found != 3){
+    printf("%s: proc or inode lock missing\n", s);
+    exit(1);
+  }
+  if(lockstat(info, 1, 0) != 1){
+    printf("%s: lockstat ignored its limit\n", s);
+    exit(1);
+  }
+}
+
+// the profiler catches this process spinning in user space.
+void
+proftest(char *s)
+{
+  static struct sample buf[256];
+  int i, n, t, pid, found;
+
+  if(prof(PROF_START, 0, 0) != 0){
+    printf("%s: prof start failed\n", s);
+    exit(1);
+  }
+  t = uptime();
+  while(uptime() < t + 5)
+    ;
+  if(prof(PROF_STOP, 0, 0) < 0){
+    printf("%s: prof stop failed\n", s);
+    exit(1);
+  }
+  pid = getpid();
+  found = 0;
+  while((n = prof(PROF_READ, buf, 256)) > 0){
+    for(i = 0; i < n; i++){
+      if(buf[i].user && buf[i].pid == pid && buf[i].pc < MAXVA)
+        found = 1;
+    }
+  }
+  if(n < 0){
+    printf("%s: prof read failed\n", s);
+    exit(1);
+  }
+  if(!found){
+    printf("%s: no samples of this process\n", s);
+    exit(1);
+  }
+  if(prof(PROF_READ, (struct sample*)0xffffffffffff, 1) != 0){
+    printf("%s: prof read after drain\n", s);
+    exit(1);
+  }
+  if(prof(99, 0, 0) != -1){
+    printf("%s: prof accepted a bad command\n", s);
+    exit(1);
+  }
+}
+
+// ktrace() records this process's system calls and
+// the file system's block reads and writes.
+void
+ktracetest(char *s)
+{
+  static struct trec buf[256];
+  int i, n, fd, pid, found;
+
+  if(ktrace(TRACE_START, 0, 0) != 0){
+    printf("%s: ktrace start failed\n", s);
+    exit(1);
+  }
+  fd = open("ktracef", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, "x", 1) != 1){
+    printf("%s: create ktracef failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(ktrace(TRACE_STOP, 0, 0) < 0){
+    printf("%s: ktrace stop failed\n", s);
+    exit(1);
+  }
+  unlink("ktracef");
+
+  pid = getpid();
+  found = 0;
+  while((n = ktrace(TRACE_READ, buf, 256)) > 0){
+    for(i = 0; i < n; i++){
+      if(buf[i].pid != pid)
+        continue;
+      if(buf[i].type == TR_SYSENTER && buf[i].a0 == SYS_write)
+        found |= 1;
+      if(buf[i].type == TR_SYSEXIT && buf[i].a0 == SYS_write && buf[i].a1 == 1)
+        found |= 2;
+      if(buf[i].type == TR_BREAD || buf[i].type == TR_BWRITE)
+        found |= 4;
+    }
+  }
+  if(n < 0){
+    printf("%s: ktrace read failed\n", s);
+    exit(1);
+  }
+  if(found != 7){
+    printf("%s: missing records (%d)\n", s, found);
+    exit(1);
+  }
+}
+
+// wait() adds a child's resource usage to the parent's.
+void
+rusagetest(char *s)
+{
+  struct rusage r0, r;
+  char buf[100];
+  int i, fd, pid, fds[2];
+
+  if(getrusage(RUSAGE_SELF, &r) < 0 || r.nsyscall == 0){
+    printf("%s: getrusage self failed\n", s);
+    exit(1);
+  }
+  if(getrusage(RUSAGE_CHILDREN, &r0) < 0){
+    printf("%s: getrusage children failed\n", s);
+    exit(1);
+  }
+  if(getrusage(7, &r) != -1){
+    printf("%s: getrusage accepted a bad who\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < 100; i++)
+      _getpid();
+    if(pipe(fds) < 0)
+      exit(1);
+    for(i = 0; i < 10; i++){
+      if(write(fds[1], buf, sizeof(buf)) != sizeof(buf) ||
+         read(fds[0], buf, sizeof(buf)) != sizeof(buf))
+        exit(1);
+    }
+    fd = open("rusagef", O_CREATE|O_RDWR);
+    if(fd < 0 || write(fd, buf, sizeof(buf)) != sizeof(buf))
+      exit(1);
+    close(fd);
+    unlink("rusagef");
+    exit(0);
+  }
+  wait(0);
+
+  if(getrusage(RUSAGE_CHILDREN, &r) < 0){
+    printf("%s: getrusage children failed\n", s);
+    exit(1);
+  }
+  if(r.nsyscall - r0.nsyscall < 100 || r.piped - r0.piped != 1000 ||
+     r.oublock - r0.oublock == 0){
+    printf("%s: child's usage not counted\n", s);
+    exit(1);
+  }
+}
+
+// dmesg() returns kernel printf() output, such as
+// the complaint about a child's bad memory reference.
+void
+dmesgtest(char *s)
+{
+  static char buf[4096];
+  char *msg = "usertrap(): unexpected scause";
+  int i, n, pid, found;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    *(volatile char*)MAXVA;
+    exit(0);
+  }
+  wait(0);
+
+  n = dmesg(buf, sizeof(buf));
+  if(n <= 0 || n > sizeof(buf)){
+    printf("%s: dmesg returned %d\n", s, n);
+    exit(1);
+  }
+  found = 0;
+  for(i = 0; i + strlen(msg) <= n; i++){
+    if(memcmp(buf + i, msg, strlen(msg)) == 0)
+      found = 1;
+  }
+  if(!found){
+    printf("%s: dmesg lacks the fault message\n", s);
+    exit(1);
+  }
+  if(dmesg(buf, -1) != -1){
+    printf("%s: dmesg accepted a negative count\n", s);
+    exit(1);
+  }
+}
+
+// ioctl() switches the console between cooked and raw input.
+void
+consolemodetest(char *s)
+{
+  int fd, mode, fds[2];
+
+  fd = open("/console", O_RDWR);
+  if(fd < 0){
+    printf("%s: open console failed\n", s);
+    exit(1);
+  }
+  if(ioctl(fd, CONSOLE_GETMODE, 0) != CONSOLE_COOKED){
+    printf("%s: console not in cooked mode\n", s);
+    exit(1);
+  }
+  if(ioctl(fd, CONSOLE_SETMODE, CONSOLE_RAW) != 0){
+    printf("%s: set raw mode failed\n", s);
+    exit(1);
+  }
+  mode = ioctl(fd, CONSOLE_GETMODE, 0);
+  ioctl(fd, CONSOLE_SETMODE, CONSOLE_COOKED);
+  if(mode != CONSOLE_RAW){
+    printf("%s: console not in raw mode\n", s);
+    exit(1);
+  }
+  if(ioctl(fd, CONSOLE_GETMODE, 0) != CONSOLE_COOKED){
+    printf("%s: console stuck in raw mode\n", s);
+    exit(1);
+  }
+  if(ioctl(fd, CONSOLE_SETMODE, 7) != -1 || ioctl(fd, 99, 0) != -1){
+    printf("%s: bad ioctl accepted\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(ioctl(fds[0], CONSOLE_GETMODE, 0) != -1){
+    printf("%s: ioctl on a pipe succeeded\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// the disk driver counts requests, and takes no more
+// interrupts than the device has completed requests.
+// the I/O scheduler merges the log's adjacent blocks.
+void
+diskstattest(char *s)
+{
+  struct diskstat st0, st;
+  static char buf[BSIZE];
+  int i, fd;
+
+  if(diskstat(&st0) < 0 || st0.nqueue < 1){
+    printf("%s: diskstat failed\n", s);
+    exit(1);
+  }
+  fd = open("diskstatf", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  if(fsync(fd) != 0){
+    printf("%s: fsync failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("diskstatf");
+
+  if(diskstat(&st) < 0){
+    printf("%s: diskstat failed\n", s);
+    exit(1);
+  }
+  if(st.nblock - st0.nblock < 10 || st.nio - st0.nio == 0 ||
+     st.ncomplete - st0.ncomplete == 0){
+    printf("%s: disk writes not counted\n", s);
+    exit(1);
+  }
+  if(st.nmerged - st0.nmerged == 0 ||
+     st.nio - st0.nio >= st.nblock - st0.nblock){
+    printf("%s: no blocks merged\n", s);
+    exit(1);
+  }
+  if(st.nintr - st0.nintr > st.ncomplete - st0.ncomplete + 1){
+    printf("%s: more interrupts than completions\n", s);
+    exit(1);
+  }
+  if(diskstat((struct diskstat*)MAXVA) != -1){
+    printf("%s: diskstat accepted a bad address\n", s);
+    exit(1);
+  }
+}
+
+// repeated small writes to one block cost log writes only;
+// the data and inode blocks go home later, once.
+void
+writebacktest(char *s)
+{
+  struct diskstat st0, st;
+  char buf[10];
+  int i, fd, n;
+
+  fd = open("writebackf", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  if(diskstat(&st0) < 0){
+    printf("%s: diskstat failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 20; i++){
+    memset(buf, 'a' + i, sizeof(buf));
+    if(pwrite(fd, buf, sizeof(buf), 0) != sizeof(buf)){
+      printf("%s: pwrite failed\n", s);
+      exit(1);
+    }
+  }
+  if(diskstat(&st) < 0){
+    printf("%s: diskstat failed\n", s);
+    exit(1);
+  }
+  // the writes share transactions, so there is at most a
+  // commit of a few blocks now and then; committing and
+  // writing home both blocks for every write would take
+  // six blocks each.
+  n = st.nblock - st0.nblock;
+  if(n > 20*4 + 10){
+    printf("%s: %d blocks for 20 small writes\n", s, n);
+    exit(1);
+  }
+
+  if(pread(fd, buf, sizeof(buf), 0) != sizeof(buf) || buf[0] != 'a' + 19){
+    printf("%s: read back wrong data\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("writebackf");
+}
+
+// files freed soon after they are written have their
+// blocks dropped from the log; blocks allocated again
+// must still hold what was last written to them.
+void
+logcanceltest(char *s)
+{
+  static char buf[BSIZE];
+  int i, j, fd;
+
+  for(i = 0; i < 20; i++){
+    fd = open("logcancelf", O_CREATE|O_RDWR);
+    if(fd < 0){
+      printf("%s: open failed\n", s);
+      exit(1);
+    }
+    for(j = 0; j < 4; j++){
+      memset(buf, 'a' + (i + j) % 26, sizeof(buf));
+      if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+        printf("%s: write failed\n", s);
+        exit(1);
+      }
+    }
+    close(fd);
+    if(i % 2 == 0 && unlink("logcancelf") != 0){
+      printf("%s: unlink failed\n", s);
+      exit(1);
+    }
+  }
+
+  fd = open("logcancelf", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  for(j = 0; j < 4; j++){
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf) ||
+       buf[0] != 'a' + (19 + j) % 26 || buf[BSIZE-1] != buf[0]){
+      printf("%s: wrong data in block %d\n", s, j);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("logcancelf");
+}
+
+// end_op() leaves the transaction open; fsync() and
+// sync() commit it.
+void
+fsynctest(char *s)
+{
+  struct diskstat st0, st1, st2;
+  char buf[10];
+  int i, fd, fds[2];
+
+  fd = open("fsyncf", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  if(fsync(fd) != 0 || sync() != 0){
+    printf("%s: sync failed\n", s);
+    exit(1);
+  }
+
+  diskstat(&st0);
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < 20; i++){
+    if(pwrite(fd, buf, sizeof(buf), i * sizeof(buf)) != sizeof(buf)){
+      printf("%s: pwrite failed\n", s);
+      exit(1);
+    }
+  }
+  diskstat(&st1);
+  if(fsync(fd) != 0){
+    printf("%s: fsync failed\n", s);
+    exit(1);
+  }
+  diskstat(&st2);
+
+  // a commit on the timer may fall in between, but not
+  // one for every write.
+  if(st1.nblock - st0.nblock > 10){
+    printf("%s: writes committed before fsync\n", s);
+    exit(1);
+  }
+  if(st2.nblock - st1.nblock == 0 && st1.nblock - st0.nblock == 0){
+    printf("%s: fsync wrote nothing\n", s);
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(fsync(fds[0]) != -1 || fsync(-1) != -1){
+    printf("%s: fsync accepted a bad fd\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  close(fd);
+  unlink("fsyncf");
+}
+
+// getpid() and uptime() read pages the kernel maps
+// read-only into each process.
+void
+usyscalltest(char *s)
+{
+  int pid, xstatus, t;
+
+  if(getpid() != _getpid()){
+    printf("%s: getpid %d, system call says %d\n", s, getpid(), _getpid());
+    exit(1);
+  }
+  t = uptime();
+  if(t > _uptime() || _uptime() - t > 1){
+    printf("%s: uptime %d, system call says %d\n", s, t, _uptime());
+    exit(1);
+  }
+  sleep(2);
+  if(uptime() < t + 2){
+    printf("%s: uptime did not advance\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(getpid() != _getpid())
+      exit(1);
+    // the page is read-only; this should kill us.
+    ((struct usyscall*)USYSCALL)->pid = 0;
+    exit(2);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: child status %d\n", s, xstatus);
+    exit(1);
+  }
+}
+
 // meant to be run w/ at most two CPUs
 void
 preempt(char *s)
@@ -1918,7 +2736,7 @@ iref(char *s)
 void
 forktest(char *s)
 {
-  enum{ N = 1000 };
+  enum{ N = 5000 };
   int n, pid;
 
   for(n=0; n<N; n++){
@@ -1935,7 +2753,7 @@ forktest(char *s)
   }
 
   if(n == N){
-    printf("%s: fork claimed to work 1000 times!\n", s);
+    printf("%s: fork claimed to work %d times!\n", s, N);
     exit(1);
   }
 
@@ -2364,6 +3182,46 @@ stacktest(char *s)
     exit(xstatus);
 }
 
+// the page below the user stack is mapped, but not for user
+// access, so system calls must refuse to copy to or from it.
+void
+guardcopy(char *s)
+{
+  char *guard = (char *) (PGROUNDDOWN(r_sp()) - PGSIZE);
+  int fd, n;
+
+  fd = open("README", 0);
+  if(fd < 0){
+    printf("%s: open(README) failed\n", s);
+    exit(1);
+  }
+  n = read(fd, guard, 64);
+  if(n != -1){
+    printf("%s: read(fd, %p, 64) returned %d, not -1\n", s, guard, n);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("guardcopy", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    printf("%s: open(guardcopy) failed\n", s);
+    exit(1);
+  }
+  n = write(fd, guard, 64);
+  if(n != -1){
+    printf("%s: write(fd, %p, 64) returned %d, not -1\n", s, guard, n);
+    exit(1);
+  }
+  close(fd);
+  unlink("guardcopy");
+
+  fd = open(guard, 0);
+  if(fd >= 0){
+    printf("%s: open(%p) returned %d, not -1\n", s, guard, fd);
+    exit(1);
+  }
+}
+
 // regression test. copyin(), copyout(), and copyinstr() used to cast
 // the virtual page address to uint, which (with certain wild system
 // call arguments) resulted in a kernel page faults.
@@ -2676,6 +3534,7 @@ main(int argc, char *argv[])
     {sbrkarg, "sbrkarg"},
     {validatetest, "validatetest"},
     {stacktest, "stacktest"},
+    {guardcopy, "guardcopy"},
     {opentest, "opentest"},
     {writetest, "writetest"},
     {writebig, "writebig"},
@@ -2685,6 +3544,21 @@ main(int argc, char *argv[])
     {iputtest, "iput"},
     {mem, "mem"},
     {pipe1, "pipe1"},
+    {splicetest, "splicetest"},
+    {iovtest, "iovtest"},
+    {stdiotest, "stdiotest"},
+    {ringtest, "ringtest"},
+    {lockstattest, "lockstattest"},
+    {usyscalltest, "usyscalltest"},
+    {proftest, "proftest"},
+    {ktracetest, "ktracetest"},
+    {rusagetest, "rusagetest"},
+    {dmesgtest, "dmesgtest"},
+    {consolemodetest, "consolemodetest"},
+    {diskstattest, "diskstattest"},
+    {writebacktest, "writebacktest"},
+    {logcanceltest, "logcanceltest"},
+    {fsynctest, "fsynctest"},
     {preempt, "preempt"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
@@ -1,6 +1,7 @@
 #include "kernel/types.h"
 #include "user/user.h"
 #include "kernel/param.h"
+#include "user/stdio.h"
 
 int main(int argc, char *argv[]){
 
@@ -9,10 +10,10 @@ int main(int argc, char *argv[]){
         new_argv[i-1] = argv[i];
     }
     int new_argv_num = argc-1;
-    char c;
+    int c;
     char buf[128], *argv_buf=buf;
     new_argv[new_argv_num++] = argv_buf;
-    while(read(0, &c, sizeof(char))){
+    while((c = fgetc(stdin)) != EOF){
         if(c==' '){
             *argv_buf++='\0';
             new_argv[new_argv_num++] = argv_buf;